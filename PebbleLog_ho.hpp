@@ -3,37 +3,164 @@
  * @brief header_only file for pebble log
  */
 
+#include <array>
 #include <atomic>
+#include <bit>
+#include <charconv>
+#include <chrono>
 #include <condition_variable>
+#include <coroutine>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
 #include <format>
+#include <iterator>
 #include <memory>
 #include <mutex>
-#include <queue>
+#include <optional>
+#include <deque>
 #include <sstream>
 #include <thread>
+#include <utility>
 #include <vector>
 
 #ifndef WIN32
 #include <iostream>
 #endif// !WIN32
 
+#ifndef _WIN32
+#include <climits>
+#include <sys/uio.h>// writev
+#endif
+
+// ɹϵͳҵ zlib ʱ壬
+#ifdef PEBBLELOG_HAS_ZLIB
+#include <zlib.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+#define PEBBLELOG_HAS_RDTSC
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+#endif
+
 #include <functional>
 #include <future>
 
-class ThreadPool {
+namespace utils::Log {
+    // ̷߳ѡں̨̺̳̣߳߳߳־߳ռöӳеĺ
+    struct ThreadPlacement {
+        std::vector<int> cpus;       // 󶨵Щ CPUΪձʾ
+        std::string name;            // ߳Linux ϳ 15 ַĲֱض
+        std::optional<int> niceValue;// ȼnice ֵԽԽͣΪձʾ
+    };
+
+    // ѷѡӦõǰ̣߳ȫɹʱ true
+    inline bool applyThreadPlacement(const ThreadPlacement &placement);
+}// namespace utils::Log
+
+// ֻƶ󣺲 kInlineSize ĿɵöֱӴڲڴ
+class PoolTask {
 public:
-    ThreadPool(size_t threads) {
-        // ʹ std::jthread  std::threadԶ
-        for (size_t i = 0; i < threads; ++i) {
-            workers.emplace_back([this] { worker(); });
+    static constexpr size_t kInlineSize = 48;
+
+    PoolTask() = default;
+
+    template<class F>
+        requires(!std::is_same_v<std::decay_t<F>, PoolTask>)
+    PoolTask(F &&f) {
+        using Fn = std::decay_t<F>;
+        if constexpr (sizeof(Fn) <= kInlineSize && alignof(Fn) <= alignof(std::max_align_t) &&
+                      std::is_nothrow_move_constructible_v<Fn>) {
+            new (storage) Fn(std::forward<F>(f));
+            ops = &inlineOps<Fn>;
+        } else {
+            *reinterpret_cast<Fn **>(storage) = new Fn(std::forward<F>(f));
+            ops = &heapOps<Fn>;
+        }
+    }
+
+    PoolTask(PoolTask &&other) noexcept { moveFrom(other); }
+
+    PoolTask &operator=(PoolTask &&other) noexcept {
+        if (this != &other) {
+            reset();
+            moveFrom(other);
+        }
+        return *this;
+    }
+
+    PoolTask(const PoolTask &) = delete;
+    PoolTask &operator=(const PoolTask &) = delete;
+
+    ~PoolTask() { reset(); }
+
+    explicit operator bool() const { return ops != nullptr; }
+
+    void operator()() { ops->invoke(storage); }
+
+    void reset() {
+        if (ops) {
+            ops->destroy(storage);
+            ops = nullptr;
         }
     }
 
+private:
+    struct Ops {
+        void (*invoke)(void *);
+        void (*move)(void *to, void *from);
+        void (*destroy)(void *);
+    };
+
+    template<class Fn>
+    static constexpr Ops inlineOps = {
+            [](void *p) { (*static_cast<Fn *>(p))(); },
+            [](void *to, void *from) {
+                new (to) Fn(std::move(*static_cast<Fn *>(from)));
+                static_cast<Fn *>(from)->~Fn();
+            },
+            [](void *p) { static_cast<Fn *>(p)->~Fn(); }};
+
+    template<class Fn>
+    static constexpr Ops heapOps = {
+            [](void *p) { (**static_cast<Fn **>(p))(); },
+            [](void *to, void *from) { *static_cast<Fn **>(to) = *static_cast<Fn **>(from); },
+            [](void *p) { delete *static_cast<Fn **>(p); }};
+
+    void moveFrom(PoolTask &other) {
+        ops = other.ops;
+        if (ops) {
+            ops->move(storage, other.storage);
+            other.ops = nullptr;
+        }
+    }
+
+    alignas(std::max_align_t) unsigned char storage[kInlineSize];
+    const Ops *ops = nullptr;
+};
+
+// ȡ̳߳أÿ߳Լ˫˶УChase-Lev߳ύԼĶУ
+// ⲿ߳ύ빲עУе̴߳עк̵߳Ķβȡ
+// ڵԤȷĽڵȡȶʱύ񲻷ڴ档
+// ̺߳ͽڵڵһύʱŴӲύĽ̲̣߳߳Ϊ 0 ʱύֱִ߳
+class ThreadPool {
+public:
+    static constexpr size_t kQueueCapacity = 1024;// ÿ˫˶кעе 2 
+    static constexpr size_t kNodeCount = 4096;    // ԤȷڵӶϷ
+
+    ThreadPool(size_t threads) : threadCount(threads) {}
+
     ~ThreadPool() {
-        // ȫֹͣ߳
+        // ọֹ̈̄ͣ߳ύִ˳
         {
-            std::unique_lock<std::mutex> lock(queue_mutex);
-            stop = true;
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            stop.store(true, std::memory_order_seq_cst);
         }
         condition.notify_all();
         for (std::jthread &worker: workers) {
@@ -41,44 +168,287 @@ public:
         }
     }
 
-    // ύ̳߳
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(startMutex);
+        return threadCount;
+    }
+
+    // ֻǰ޸߳ʱ false
+    bool resize(size_t threads) {
+        std::lock_guard<std::mutex> lock(startMutex);
+        if (started.load(std::memory_order_relaxed)) return false;
+        threadCount = threads;
+        return true;
+    }
+
+    // ύ񣬲 futureûй߳ʱڵǰֱִ߳
+    template<class F>
+    void post(F &&f) {
+        if (!started.load(std::memory_order_acquire)) start();
+        if (workers.empty()) {
+            std::forward<F>(f)();
+            return;
+        }
+        if (stop.load(std::memory_order_relaxed)) throw std::runtime_error("enqueue on stopped ThreadPool");
+        Node *node = acquireNode();
+        node->task = PoolTask(std::forward<F>(f));
+        if (currentWorker.pool != this || !queues[currentWorker.index]->push(node)) {
+            pushInject(node);
+        }
+        pending.fetch_add(1, std::memory_order_seq_cst);
+        if (sleepers.load(std::memory_order_seq_cst) > 0) {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            condition.notify_one();
+        }
+    }
+
+    // ύ̳߳أͨ future ȡý
     template<class F, class... Args>
-    auto enqueue(F &&f, Args &&...args) -> std::future<typename std::result_of<F(Args...)>::type> {
-        using return_type = typename std::result_of<F(Args...)>::type;
+    auto enqueue(F &&f, Args &&...args) -> std::future<std::invoke_result_t<F, Args...>> {
+        using return_type = std::invoke_result_t<F, Args...>;
 
-        auto task = std::make_shared<std::packaged_task<return_type()>>(
-                std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+        std::packaged_task<return_type()> task(
+                [f = std::forward<F>(f), ... args = std::forward<Args>(args)]() mutable { return std::invoke(std::move(f), std::move(args)...); });
+        std::future<return_type> res = task.get_future();
+        post(std::move(task));
+        return res;
+    }
 
-        std::future<return_type> res = task->get_future();
+    // ɸ߳´λʱӦã߳ʱ "-" ָ߳
+    void setPlacement(const utils::Log::ThreadPlacement &newPlacement) {
         {
-            std::unique_lock<std::mutex> lock(queue_mutex);
-            if (stop) throw std::runtime_error("enqueue on stopped ThreadPool");
-            tasks.emplace([task]() { (*task)(); });
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            placement = newPlacement;
+            placementVersion.fetch_add(1, std::memory_order_release);
         }
-        condition.notify_one();
-        return res;
+        condition.notify_all();
     }
 
 private:
-    void worker() {
+    static constexpr uint32_t kNoNode = UINT32_MAX;
+
+    void start() {
+        std::lock_guard<std::mutex> lock(startMutex);
+        if (started.load(std::memory_order_relaxed)) return;
+        if (threadCount > 0) {
+            nodes = std::make_unique<Node[]>(kNodeCount);
+            for (uint32_t i = 0; i < kNodeCount; ++i) {
+                nodes[i].next.store(i + 1 < kNodeCount ? i + 1 : kNoNode, std::memory_order_relaxed);
+            }
+            freeHead.store(0, std::memory_order_relaxed);
+            injectSlots = std::make_unique<InjectSlot[]>(kQueueCapacity);
+            for (size_t i = 0; i < kQueueCapacity; ++i) injectSlots[i].sequence.store(i, std::memory_order_relaxed);
+
+            queues.reserve(threadCount);
+            for (size_t i = 0; i < threadCount; ++i) queues.push_back(std::make_unique<WorkStealingDeque>());
+            // ʹ std::jthread  std::threadԶ
+            for (size_t i = 0; i < threadCount; ++i) {
+                workers.emplace_back([this, i] { worker(i); });
+            }
+        }
+        started.store(true, std::memory_order_release);
+    }
+
+    struct Node {
+        PoolTask task;
+        std::atomic<uint32_t> next{kNoNode};// еһڵ
+        bool fromHeap = false;
+    };
+
+    // Chase-Lev ˫˶Уڵײѹ͵̴߳Ӷȡ
+    class WorkStealingDeque {
+    public:
+        bool push(Node *node) {
+            int64_t b = bottom.load(std::memory_order_relaxed);
+            int64_t t = top.load(std::memory_order_acquire);
+            if (b - t >= static_cast<int64_t>(kQueueCapacity)) return false;
+            buffer[b & kMask].store(node, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return true;
+        }
+
+        Node *pop() {
+            int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+            bottom.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t t = top.load(std::memory_order_relaxed);
+            if (t > b) {
+                bottom.store(b + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            Node *node = buffer[b & kMask].load(std::memory_order_relaxed);
+            if (t == b) {
+                // ֻʣһȡ߾
+                if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) node = nullptr;
+                bottom.store(b + 1, std::memory_order_relaxed);
+            }
+            return node;
+        }
+
+        Node *steal() {
+            int64_t t = top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t b = bottom.load(std::memory_order_acquire);
+            if (t >= b) return nullptr;
+            Node *node = buffer[t & kMask].load(std::memory_order_relaxed);
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) return nullptr;
+            return node;
+        }
+
+    private:
+        static constexpr int64_t kMask = kQueueCapacity - 1;
+
+        alignas(64) std::atomic<int64_t> top{0};
+        alignas(64) std::atomic<int64_t> bottom{0};
+        std::atomic<Node *> buffer[kQueueCapacity] = {};
+    };
+
+    // עеĲλжǷɶдн߶߶У
+    struct InjectSlot {
+        std::atomic<size_t> sequence;
+        Node *node = nullptr;
+    };
+
+    // ¼ǰ߳ĸ̳߳صĵڼֲ̣߳߳̾ʼ
+    struct WorkerContext {
+        ThreadPool *pool;
+        size_t index;
+    };
+    static inline thread_local WorkerContext currentWorker{};
+
+    // ʹ "汾 << 32 | ڵ±" ʽ ABA 
+    Node *acquireNode() {
+        uint64_t head = freeHead.load(std::memory_order_acquire);
+        while (static_cast<uint32_t>(head) != kNoNode) {
+            uint32_t index = static_cast<uint32_t>(head);
+            uint64_t next = ((head >> 32) + 1) << 32 | nodes[index].next.load(std::memory_order_relaxed);
+            if (freeHead.compare_exchange_weak(head, next, std::memory_order_acquire, std::memory_order_acquire)) {
+                return &nodes[index];
+            }
+        }
+        Node *node = new Node;
+        node->fromHeap = true;
+        return node;
+    }
+
+    void releaseNode(Node *node) {
+        node->task.reset();
+        if (node->fromHeap) {
+            delete node;
+            return;
+        }
+        uint32_t index = static_cast<uint32_t>(node - nodes.get());
+        uint64_t head = freeHead.load(std::memory_order_relaxed);
+        uint64_t next;
+        do {
+            node->next.store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+            next = ((head >> 32) + 1) << 32 | index;
+        } while (!freeHead.compare_exchange_weak(head, next, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    void pushInject(Node *node) {
+        size_t position = injectTail.load(std::memory_order_relaxed);
         while (true) {
-            std::function<void()> task;
-            {
-                std::unique_lock<std::mutex> lock(queue_mutex);
-                condition.wait(lock, [this] { return stop || !tasks.empty(); });
-                if (stop && tasks.empty()) return;// ߳˳
-                task = std::move(tasks.front());
-                tasks.pop();
+            InjectSlot &slot = injectSlots[position & (kQueueCapacity - 1)];
+            size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+            if (diff == 0) {
+                if (injectTail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    slot.node = node;
+                    slot.sequence.store(position + 1, std::memory_order_release);
+                    return;
+                }
+            } else if (diff < 0) {
+                std::this_thread::yield();// ȴ߳ȡ
+                position = injectTail.load(std::memory_order_relaxed);
+            } else {
+                position = injectTail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    Node *popInject() {
+        size_t position = injectHead.load(std::memory_order_relaxed);
+        while (true) {
+            InjectSlot &slot = injectSlots[position & (kQueueCapacity - 1)];
+            size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+            if (diff == 0) {
+                if (injectHead.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    Node *node = slot.node;
+                    slot.sequence.store(position + kQueueCapacity, std::memory_order_release);
+                    return node;
+                }
+            } else if (diff < 0) {
+                return nullptr;// Ϊ
+            } else {
+                position = injectHead.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // ȡԼĶУȡעУ߳ȡ
+    Node *findWork(size_t index) {
+        if (Node *node = queues[index]->pop()) return node;
+        if (Node *node = popInject()) return node;
+        for (size_t i = 1; i < queues.size(); ++i) {
+            if (Node *node = queues[(index + i) % queues.size()]->steal()) return node;
+        }
+        return nullptr;
+    }
+
+    void worker(size_t index) {
+        currentWorker = {this, index};
+        uint64_t appliedPlacement = 0;
+        while (true) {
+            if (placementVersion.load(std::memory_order_acquire) != appliedPlacement) {
+                utils::Log::ThreadPlacement newPlacement;
+                {
+                    std::lock_guard<std::mutex> lock(sleepMutex);
+                    newPlacement = placement;
+                    appliedPlacement = placementVersion.load(std::memory_order_relaxed);
+                }
+                if (!newPlacement.name.empty()) newPlacement.name += "-" + std::to_string(index);
+                utils::Log::applyThreadPlacement(newPlacement);
+            }
+
+            if (Node *node = findWork(index)) {
+                pending.fetch_sub(1, std::memory_order_relaxed);
+                node->task();
+                releaseNode(node);
+                continue;
             }
-            task();
+
+            // ȵǼΪȴټǷ post ȼټȴϣ©
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            sleepers.fetch_add(1, std::memory_order_seq_cst);
+            condition.wait(lock, [this, appliedPlacement] {
+                return pending.load(std::memory_order_seq_cst) > 0 || stop.load(std::memory_order_relaxed) ||
+                       placementVersion.load(std::memory_order_relaxed) != appliedPlacement;
+            });
+            sleepers.fetch_sub(1, std::memory_order_relaxed);
+            if (stop.load(std::memory_order_relaxed) && pending.load(std::memory_order_seq_cst) == 0) return;// ߳˳
         }
     }
 
+    std::unique_ptr<Node[]> nodes;
+    alignas(64) std::atomic<uint64_t> freeHead{0};
+    std::unique_ptr<InjectSlot[]> injectSlots;
+    alignas(64) std::atomic<size_t> injectHead{0};
+    alignas(64) std::atomic<size_t> injectTail{0};
+    alignas(64) std::atomic<int64_t> pending{0};// ύδȡߵ
+    std::atomic<int> sleepers{0};
+    std::atomic<bool> stop{false};
+    std::vector<std::unique_ptr<WorkStealingDeque>> queues;
     std::vector<std::jthread> workers;
-    std::queue<std::function<void()>> tasks;
-    std::mutex queue_mutex;
+    mutable std::mutex startMutex;
+    size_t threadCount;//  startMutex 
+    std::atomic<bool> started{false};
+    std::mutex sleepMutex;
     std::condition_variable condition;
-    bool stop = false;
+    utils::Log::ThreadPlacement placement;
+    std::atomic<uint64_t> placementVersion{0};
 };
 
 namespace utils::Log::MiddleWare {
@@ -130,445 +500,4871 @@ namespace utils::Log {
     enum class LogType {
         CONSOLE,
         FILE,
-        BOTH
+        BOTH,
+        NONE// ¼ճǰ˺ͺ̨ڻ׼
     };
 
-    class PebbleLog {
-        friend class MiddlewareChain;// м˽гԱ
-    public:
-        // ־¼
-        template<typename... Args>
-        static void info(const std::string_view formatStr, Args &&...args) {
-            log(LogLevel::INFO, std::vformat(formatStr, std::make_format_args(args...)));
-        }
-        template<typename... Args>
-        static void debug(const std::string_view formatStr, Args &&...args) {
-            log(LogLevel::DEBUG, std::vformat(formatStr, std::make_format_args(args...)));
-        }
-        template<typename... Args>
-        static void warn(const std::string_view formatStr, Args &&...args) {
-            log(LogLevel::WARN, std::vformat(formatStr, std::make_format_args(args...)));
-        }
-        template<typename... Args>
-        static void error(const std::string_view formatStr, Args &&...args) {
-            log(LogLevel::ERROR, std::vformat(formatStr, std::make_format_args(args...)));
-        }
-        template<typename... Args>
-        static void fatal(const std::string_view formatStr, Args &&...args) {
-            log(LogLevel::FATAL, std::vformat(formatStr, std::make_format_args(args...)));
-        }
-        template<typename... Args>
-        static void trace(const std::string_view formatStr, Args &&...args) {
-            log(LogLevel::TRACE, std::vformat(formatStr, std::make_format_args(args...)));
-        }
+    // ÿ¼ʽ
+    enum class OutputFormat {
+        TEXT,       // ʽԭĬϣ
+        SINGLE_LINE,// ıϢеĻкͿַת壬һ¼ֻռһ
+        JSON        // ÿ¼һ JSON 󣬺 setPattern
+    };
 
-        // ־
-        static void log(LogLevel level, std::string_view message);
+    enum class ConsoleTarget {
+        STDOUT,
+        STDERR
+    };
 
-        // ÷
-        static void setLogLevel(LogLevel level);
-        static void setLogType(LogType type);
-        static void setMaxFileSize(size_t size);
-        static void setMaxFileCount(size_t count);
-        static void setLogPath(const std::string &path);
-        static void setLogName(const std::string &name);
-        static void setTimeFormat(const std::string &format);
-        static void setConsolePrefixFormat(const std::string &prefix);
-        static void setFilePrefixFormat(const std::string &format);
+    // ̵̨߳ȴ¼¼ķʽ
+    enum class WaitStrategy {
+        BLOCKING,  // ȴĬϣʱռ CPU
+        SPIN_YIELD,// һʱ䣬֮ÿμǰó CPU
+        SLEEP,     // ̶ѯ
+        BUSY_SPIN  // һֱӳͣռһ
+    };
 
-        static const std::string &getLogName();
-        static const std::string &getConsolePrefixFormat();
+    // ¼дʽ
+    enum class BackendMode {
+        ASYNC,// Ӻɺ̨߳дĬϣ̨߳ڵһ¼ʱ
+        SYNC  // ڵֱ߳дκκ̵̨̣߳߳д
+    };
 
-        // ڼ¼ĳκڲ
-        template<typename Func, typename... Args>
-        static void traceFunction(const char *file, int line, const char *function, Func &&func, Args &&...args) {
-            std::ostringstream oss;
-            oss << "File: " << file << ", Line: " << line << ", Function: " << function << " | ";
-            oss << "Args: ";
-            ((oss << args << " (" << typeid(args).name() << "), "), ...);
-            std::string logMessage = oss.str();
-            if (!logMessage.empty() && logMessage.back() == ' ') {
-                logMessage.pop_back();// ƳĩβĿո
-            }
-            if (!logMessage.empty() && logMessage.back() == ',') {
-                logMessage.pop_back();// ƳĩβĶ
-            }
-            log(LogLevel::TRACE, logMessage);
+    enum class TimestampSource {
+        SYSTEM,// ÿ¼ȡϵͳʱ䣨Ĭϣ
+        TSC    // ֻ¼ rdtscɺ̨㣻TSC Ƶʲ㶨ʱ˻ CLOCK_MONOTONIC_COARSE
+    };
 
-            // ִк¼ֵ
-            auto result = func(std::forward<Args>(args)...);
-            oss.str("");
-            oss << "Return: " << result << " (" << typeid(result).name() << ")";
-            log(LogLevel::TRACE, oss.str());
-        }
+    // ˢ²ԣϣȫرռӲˢ£ֻڻд flush() ˳ʱд
+    struct FlushPolicy {
+        std::optional<LogLevel> level;        // 𲻵 level ļ¼дˢ
+        std::chrono::milliseconds interval{0};// ÿ interval ˢһΣ0 ʾر
+        size_t bytes = 0;                     // δˢݴﵽ bytes ֽʱˢ£0 ʾر
+        bool onIdle = true;                   // дʱˢ£ʱɼ
 
-        // мĴ
-        class MiddlewareProxy {
-        public:
-            // ֱӽмʵ֧ʱ
-            template<typename MiddlewareType>
-            MiddlewareProxy &operator|(MiddlewareType &&middleware) {
-                using DecayedType = std::decay_t<MiddlewareType>;
-                getInstance().middlewareChain.addMiddleware<DecayedType>(std::forward<MiddlewareType>(middleware));
-                return *this;
-            }
-        };
+        static FlushPolicy never() { return {std::nullopt, std::chrono::milliseconds(0), 0, false}; }
+    };
 
-        class LogStream {
-        public:
-            // 
-            template<typename T>
-            LogStream &operator<<(const T &message) {
-                if (!stream_) {
-                    stream_ = std::make_unique<std::ostringstream>();
-                }
-                (*stream_) << message;// Ϣд뻺
-                return *this;
-            }
+    // Ӧ̨ѹ highWatermark ӿдʱһЧͼ
+    // ֮ÿһҪĻѹѹ lowWatermark  holdTime ָһ
+    // ζ DEBUGͬ TRACEINFOWARNൽ maxLevelERROR  FATAL ᱻ
+    struct LoadSheddingPolicy {
+        size_t highWatermark = 0;// 0 ʾر
+        size_t lowWatermark = 0;
+        std::chrono::milliseconds holdTime{1000};
+        LogLevel maxLevel = LogLevel::INFO;
 
-            // д־¼
-            ~LogStream() {
-                if (stream_ && stream_->tellp() > 0) {                // 
-                    PebbleLog::log(logProperty.level, stream_->str());// ú־
-                }
-            }
+        bool enabled() const { return highWatermark > 0; }
+    };
 
-        private:
-            std::unique_ptr<std::ostringstream> stream_;// ƴϢ
-        };
-        //̬ LogStream 
-        static LogStream log() {
-            return LogStream();
-        }
+    enum class SocketType {
+        DATAGRAM,// ÿ¼һݱ
+        STREAM   // ʽӣ¼ǰ׺
+    };
 
-        // ̬ȡ
-        static MiddlewareProxy middleware() { return {}; }
+    enum class SocketFraming {
+        SYSLOG,// RFC 5424ʽʱ RFC 6587 ӳǰ׺
+        NATIVE // 4 ֽС˳ + ʽɵһ
+    };
 
-        // мط
-        template<typename MiddlewareType, typename... Args>
-        static void addMiddleware(Args &&...args) {
-            getInstance().middlewareChain.addMiddleware<MiddlewareType>(
-                    std::forward<Args>(args)...);
-        }
+    // ׽ѡ PebbleLog::enableSocketSink
+    struct SocketSinkOptions {
+        std::string path = "/dev/log";// Unix ׽·
+        SocketType type = SocketType::DATAGRAM;
+        SocketFraming framing = SocketFraming::SYSLOG;
+        std::string appName;                              // syslog  APP-NAMEΪʱ "-"
+        int facility = 1;                                 // syslog  facilityĬ user
+        size_t bufferLimit = 4 * 1024 * 1024;             // ȴ͵ޣֽڣ¼¼
+        std::chrono::milliseconds reconnectInterval{1000};// ʧܻϿԵļ
+    };
 
-        template<typename MiddlewareType, typename... Args>
-        PebbleLog &operator|(Args &&...args) {
-            addMiddleware<MiddlewareType>(std::forward<Args>(args)...);
-            return *this;
-        }
+    struct SocketSinkStats {
+        uint64_t sent = 0;      // ѷ͵ļ¼
+        uint64_t dropped = 0;   // ݳޡݱ޻ֹͣʱδļ¼
+        uint64_t sendCalls = 0; // sendmmsg/sendmsg/send ô
+        uint64_t reconnects = 0;// ӶϿӵĴ
+    };
 
-        static void applyMiddlewares() {
-            getInstance().middlewareChain.process();
-        }
+    // ļϡÿ records  interval ʱ "<־ļ>.idx" еǼһμ¼λã
+    // Ϊ 0 ʱд־ļһת pebble-query ȡ
+    struct FileIndexPolicy {
+        size_t records = 0;
+        std::chrono::milliseconds interval{0};
 
-        // ȡ
-        static std::mutex &getMutex() { return logMutex; }
+        bool enabled() const { return records > 0 || interval.count() > 0; }
+    };
 
-    private:
-        struct LogProperty {
-            LogLevel level = LogLevel::DEBUG;
-            LogType type = LogType::CONSOLE;
-            size_t maxFileSize = 10 * 1024 * 1024;// Ĭ 10MB
-            size_t maxFileCount = 5;
-            std::string logPath = "./logs";
-            std::string logName = "app.log";
-            std::string logFullPathName;
-        };
+    // ļʽ8 ֽħ֮ǶĿÿĿ־ļһμ¼
+    // ĿһνʱдһĿ֮δ
+    namespace fileindex {
+        constexpr char kMagic[8] = {'P', 'B', 'L', 'I', 'D', 'X', '1', '\0'};
 
-        static PebbleLog &getInstance() {
-            static PebbleLog instance;
-            return instance;
-        }
+        struct Entry {
+            int64_t minNanos;  // ڼ¼ʱ䣨Unix 룩
+            int64_t maxNanos;  // ڼ¼ʱ䣻ǰȡʱ䣬ڲ֤
+            uint64_t offset;   // ־ļеʼֽ
+            uint64_t length;   // εֽ
+            uint32_t records;
+            uint32_t levelMask;// ڳֹļ𣬵 i λӦ LogLevel ĵ i ֵ
+        };
+        static_assert(sizeof(Entry) == 40, "Ŀ̸ʽСܸı");
 
-        PebbleLog();
-        ~PebbleLog();
+        inline std::string pathFor(const std::string &logFile) { return logFile + ".idx"; }
+    }// namespace fileindex
 
-        static void formatLogMessage(LogLevel level, const std::string &message, std::string &formattedMessage);
-        static void writeLogToFile(const std::string &message);
-        static void writeLogToConsole(LogLevel level, const std::string &message);
+    enum class FileCompression {
+        NONE,// ѹĬϣ
+        LZ,  // õ LZ ѹٶȿ죬ⲿ
+        ZLIB // ʱҵ zlib ſã˻ LZѹʸߣٶȽ
+    };
 
-        static LogProperty logProperty;
-        static std::mutex logMutex;
-        MiddlewareChain middlewareChain;// Ƕм
+    // ļʽѹ־ݰ frameSize гɻֱ֡ѹд "<־ļ>.pbz"
+    // ֻ֡ڴﵽ frameSize ʱˢʱδ֡Ҳдļβ֮ԭλǣ֡СˢƵӰ
+    struct FileCompressionPolicy {
+        FileCompression codec = FileCompression::NONE;
+        size_t frameSize = 256 * 1024;// δѹݴﵽôСʱһ֡
 
-        // 첽־
-        static std::queue<std::pair<LogLevel, std::string>> logQueue;
-        static std::mutex queueMutex;
-        static std::condition_variable queueCond;
-        std::atomic<bool> stopFlag;
-        std::thread logThread;
-        ThreadPool threadPool;
+        bool enabled() const { return codec != FileCompression::NONE; }
+    };
 
-        void processLogs();
+    // ļд뷽ʽdirectIo ʱƹҳ棬ȸƵҳݴһд󽻸д̣߳
+    // ͬʱһ飻֧ O_DIRECT ļϵͳ˻ͨд롣preallocate ڴļʱԤ maxFileSize Ŀռ䣬
+    // ıļȣرʱͷδĲ
+    struct FileIoPolicy {
+        bool directIo = false;
+        bool preallocate = false;
+        size_t stagingSize = 1024 * 1024;// ÿݴĴСȡҳ
     };
 
-}// namespace utils::Log
+    // ѹļʽ֡βɣÿ֡Ƕ֡ͷѹݣ֮֡䲻ֵ䣬
+    // һ֡ͷʼܽѹ֡ͷ֡ڼ¼ʱ䷶Χͼ𣬰ʱʱؽѹ
+    namespace framefile {
+        constexpr char kMagic[4] = {'P', 'B', 'L', 'F'};
+        constexpr size_t kMaxFrameSize = 64 * 1024 * 1024;// frameSize ޣ֡ͷеĳ 32 λ
 
-#define PEBBLETRACE(func, ...) \
-    PebbleLog::traceFunction(__FILE__, __LINE__, __func__, func, ##__VA_ARGS__);
+        enum Codec : uint8_t {
+            kStored = 0,// ѹ󲻱ԭСʱԭ
+            kLz = 1,
+            kZlib = 2
+        };
 
-#include <chrono>
-#include <ctime>
-#include <mutex>
-#include <sstream>
-#include <type_traits>
+        struct Header {
+            char magic[4];
+            uint8_t codec;
+            uint8_t reserved[3];
+            uint32_t compressedLength;// ֡ͷֽ֮
+            uint32_t rawLength;
+            uint32_t records;
+            uint32_t levelMask;//  i λӦ LogLevel ĵ i ֵĿһ
+            int64_t firstNanos;// ֡ڵһ¼ʱ䣨Unix 룩
+            int64_t minNanos;  // ǰȡʱ䣬֡ڼ¼֤ʱ¼ʱ
+            int64_t maxNanos;
+        };
+        static_assert(sizeof(Header) == 48, "֡ͷ̸ʽСܸı");
 
-namespace utils::Log::MiddleWare {
+        inline std::string pathFor(const std::string &logFile) { return logFile + ".pbz"; }
 
-    // ʹ chrono ȡʱ䲢ʽΪַ
-    inline std::string getLocalTimeString(const std::string &format = "%Y-%m-%d %H:%M:%S") {
-        // ȡǰʱ
-        auto now = std::chrono::system_clock::now();
-        // תΪ time_t
-        std::time_t now_time_t = std::chrono::system_clock::to_time_t(now);
-        // תΪʱ
-        std::tm localTime;
-#ifdef _WIN32
-        localtime_s(&localTime, &now_time_t);// Windows ʹ localtime_s
+        // LZ ʽɣÿһֽڣ 4 λȣ 4 λƥ䳤ȼ 4
+        // ȡ 15 ʱֽڼۼӣС 255 ֽڽ2 ֽС˻ݾƥ䳤ȵչֽڡ
+        // һֻ
+        namespace lz {
+            constexpr size_t kMinMatch = 4;
+            constexpr size_t kMaxDistance = 65535;
+            constexpr int kHashBits = 12;
+
+            inline size_t bound(size_t size) { return size + size / 255 + 16; }
+
+            inline uint32_t load32(const char *p) {
+                uint32_t value;
+                std::memcpy(&value, p, sizeof(value));
+                return value;
+            }
+
+            inline uint32_t hash(uint32_t value) { return (value * 2654435761u) >> (32 - kHashBits); }
+
+            inline char *putLength(char *out, size_t length) {
+                for (; length >= 255; length -= 255) *out++ = static_cast<char>(255);
+                *out++ = static_cast<char>(length);
+                return out;
+            }
+
+            inline char *putSequence(char *out, const char *literals, size_t literalLength, size_t distance, size_t matchLength) {
+                char *token = out++;
+                size_t matchCode = matchLength - kMinMatch;
+                *token = static_cast<char>((std::min<size_t>(literalLength, 15) << 4) | std::min<size_t>(matchCode, 15));
+                if (literalLength >= 15) out = putLength(out, literalLength - 15);
+                std::memcpy(out, literals, literalLength);
+                out += literalLength;
+                *out++ = static_cast<char>(distance & 0xff);
+                *out++ = static_cast<char>(distance >> 8);
+                if (matchCode >= 15) out = putLength(out, matchCode - 15);
+                return out;
+            }
+
+            // out Ҫ bound(size) ֽڣѹĳ
+            inline size_t compress(const char *src, size_t size, char *out) {
+                char *begin = out;
+                size_t anchor = 0;
+                if (size > kMinMatch + 8) {
+                    uint32_t table[1 << kHashBits] = {};// λü 10 ʾ
+                    const size_t limit = size - kMinMatch - 4;// βֽΪ
+                    size_t position = 0;
+                    size_t misses = 0;
+                    while (position < limit) {
+                        uint32_t sequence = load32(src + position);
+                        uint32_t &slot = table[hash(sequence)];
+                        size_t candidate = slot;
+                        slot = static_cast<uint32_t>(position + 1);
+                        if (candidate == 0 || position - (candidate - 1) > kMaxDistance || load32(src + candidate - 1) != sequence) {
+                            // ҲƥʱӴ󲽳ѹҲܺܿ
+                            position += 1 + (misses++ >> 5);
+                            continue;
+                        }
+                        misses = 0;
+                        size_t match = candidate - 1;
+                        size_t length = kMinMatch;
+                        while (position + length < size && src[match + length] == src[position + length]) ++length;
+                        while (position > anchor && match > 0 && src[position - 1] == src[match - 1]) {
+                            --position;
+                            --match;
+                            ++length;
+                        }
+                        out = putSequence(out, src + anchor, position - anchor, position - match, length);
+                        position += length;
+                        anchor = position;
+                        if (position >= 2 && position < limit) table[hash(load32(src + position - 2))] = static_cast<uint32_t>(position - 1);
+                    }
+                }
+                size_t literalLength = size - anchor;
+                *out++ = static_cast<char>(std::min<size_t>(literalLength, 15) << 4);
+                if (literalLength >= 15) out = putLength(out, literalLength - 15);
+                std::memcpy(out, src + anchor, literalLength);
+                out += literalLength;
+                return static_cast<size_t>(out - begin);
+            }
+
+            // 벻ƻʱ falseԽд
+            inline bool decompress(const char *src, size_t size, char *out, size_t rawLength) {
+                const char *end = src + size;
+                size_t written = 0;
+                auto getLength = [&](size_t &length) {
+                    for (;;) {
+                        if (src == end) return false;
+                        uint8_t byte = static_cast<uint8_t>(*src++);
+                        length += byte;
+                        if (byte != 255) return true;
+                    }
+                };
+                while (src < end) {
+                    uint8_t token = static_cast<uint8_t>(*src++);
+                    size_t literalLength = token >> 4;
+                    if (literalLength == 15 && !getLength(literalLength)) return false;
+                    if (literalLength > static_cast<size_t>(end - src) || literalLength > rawLength - written) return false;
+                    std::memcpy(out + written, src, literalLength);
+                    src += literalLength;
+                    written += literalLength;
+                    if (src == end) break;
+
+                    if (end - src < 2) return false;
+                    size_t distance = static_cast<uint8_t>(src[0]) | (static_cast<size_t>(static_cast<uint8_t>(src[1])) << 8);
+                    src += 2;
+                    size_t matchLength = token & 15;
+                    if (matchLength == 15 && !getLength(matchLength)) return false;
+                    matchLength += kMinMatch;
+                    if (distance == 0 || distance > written || matchLength > rawLength - written) return false;
+                    // СڳʱԴĿصֻֽڸ
+                    const char *from = out + written - distance;
+                    if (distance >= matchLength) {
+                        std::memcpy(out + written, from, matchLength);
+                    } else {
+                        for (size_t i = 0; i < matchLength; ++i) out[written + i] = from[i];
+                    }
+                    written += matchLength;
+                }
+                return written == rawLength;
+            }
+        }// namespace lz
+
+        inline bool zlibAvailable() {
+#ifdef PEBBLELOG_HAS_ZLIB
+            return true;
 #else
-        localtime_r(&now_time_t, &localTime);// Linux ʹ localtime_r
+            return false;
 #endif
+        }
 
-        // ʽʱ
-        char timeStr[20];
-        std::strftime(timeStr, sizeof(timeStr), format.c_str(), &localTime);
-        return std::string(timeStr);
-    }
+        //  raw ѹһ֡׷ӵ outheader еļ¼ʱɵ÷
+        inline void encode(std::string_view raw, [[maybe_unused]] FileCompression compression, Header header, std::string &out) {
+            std::memcpy(header.magic, kMagic, sizeof(kMagic));
+            header.rawLength = static_cast<uint32_t>(raw.size());
+            size_t headerAt = out.size();
+            out.resize(headerAt + sizeof(Header) + lz::bound(raw.size()) + 64);
+            char *payload = out.data() + headerAt + sizeof(Header);
+            size_t length = 0;
+            header.codec = kLz;
+#ifdef PEBBLELOG_HAS_ZLIB
+            if (compression == FileCompression::ZLIB) {
+                uLongf zlibLength = static_cast<uLongf>(compressBound(static_cast<uLong>(raw.size())));
+                out.resize(headerAt + sizeof(Header) + std::max<size_t>(zlibLength, lz::bound(raw.size())));
+                payload = out.data() + headerAt + sizeof(Header);
+                if (compress2(reinterpret_cast<Bytef *>(payload), &zlibLength, reinterpret_cast<const Bytef *>(raw.data()), static_cast<uLong>(raw.size()),
+                              Z_BEST_SPEED) == Z_OK) {
+                    header.codec = kZlib;
+                    length = zlibLength;
+                }
+            }
+#endif
+            if (header.codec == kLz) length = lz::compress(raw.data(), raw.size(), payload);
+            if (length >= raw.size()) {
+                header.codec = kStored;
+                length = raw.size();
+                std::memcpy(payload, raw.data(), raw.size());
+            }
+            header.compressedLength = static_cast<uint32_t>(length);
+            std::memcpy(out.data() + headerAt, &header, sizeof(Header));
+            out.resize(headerAt + sizeof(Header) + length);
+        }
 
-    class LocalTimeStampMiddleware : public LoggerMiddleware<LocalTimeStampMiddleware> {
+        // ȡ data ͷ֡ͷ֡ͷЧ֡д룩ʱ false
+        inline bool readHeader(std::string_view data, Header &header) {
+            if (data.size() < sizeof(Header)) return false;
+            std::memcpy(&header, data.data(), sizeof(Header));
+            return std::memcmp(header.magic, kMagic, sizeof(kMagic)) == 0 && data.size() - sizeof(Header) >= header.compressedLength;
+        }
+
+        // ѹһ֡ݲ֣д raw
+        inline bool decode(const Header &header, std::string_view payload, std::string &raw) {
+            raw.resize(header.rawLength);
+            switch (header.codec) {
+                case kStored:
+                    if (payload.size() != header.rawLength) return false;
+                    std::memcpy(raw.data(), payload.data(), payload.size());
+                    return true;
+                case kLz:
+                    return lz::decompress(payload.data(), payload.size(), raw.data(), raw.size());
+#ifdef PEBBLELOG_HAS_ZLIB
+                case kZlib: {
+                    uLongf length = static_cast<uLongf>(raw.size());
+                    return uncompress(reinterpret_cast<Bytef *>(raw.data()), &length, reinterpret_cast<const Bytef *>(payload.data()),
+                                      static_cast<uLong>(payload.size())) == Z_OK &&
+                           length == raw.size();
+                }
+#endif
+                default:
+                    return false;
+            }
+        }
+    }// namespace framefile
+
+    // durable() ȷϣ¼ fdatasync ɺȴҲЭ co_await
+    // Ϊ true ʾ¼дȶ洢ˡûпļͬʧʱΪ false
+    class DurableAck {
     public:
-        LocalTimeStampMiddleware() : formatStr("%Y-%m-%d %H:%M:%S") {}
+        // ȷ϶Ͷеļ¼ͬУһͷ߸ɾ
+        struct State {
+            std::atomic<int> refs{1};
+            std::mutex mutex;
+            std::condition_variable cond;
+            bool done = false;
+            bool durable = false;
+            std::coroutine_handle<> continuation;
 
-        template<typename T>
-            requires std::is_constructible_v<std::string, T>
-        LocalTimeStampMiddleware(T &&format) : formatStr(std::forward<T>(format)) {
-            static_assert(!std::is_same_v<std::decay_t<T>, std::string> || !formatStr.empty(),
-                          "Time format string must not be empty.");
-            static_assert(std::is_constructible_v<std::string, T>,
-                          "Template parameter must be convertible to std::string.");
+            void retain() { refs.fetch_add(1, std::memory_order_relaxed); }
+            void release() {
+                if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) delete this;
+            }
+
+            // ڵȴЭ̣ɵ÷ĸָ̻߳
+            std::coroutine_handle<> complete(bool ok) {
+                std::coroutine_handle<> handle;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    done = true;
+                    durable = ok;
+                    handle = std::exchange(continuation, {});
+                }
+                cond.notify_all();
+                return handle;
+            }
+        };
+
+        explicit DurableAck(State *state) : state(state) {}
+        DurableAck(DurableAck &&other) noexcept : state(std::exchange(other.state, nullptr)) {}
+        DurableAck(const DurableAck &) = delete;
+        DurableAck &operator=(const DurableAck &) = delete;
+        DurableAck &operator=(DurableAck &&) = delete;
+        ~DurableAck() {
+            if (state) state->release();
         }
 
-        void process() {
-            // 浱ǰʱظ
-            auto currentTime = std::time(nullptr);
-            std::lock_guard<std::mutex> lock(PebbleLog::getMutex());
-            // ʱδʼԽ뼶ʱ߽磬ʱ
-            if (!timeStrInitialized || std::difftime(currentTime, lastUpdateTime) >= 1) {
-                timeStr = getLocalTimeString(formatStr);
-                timeStrInitialized = true;
-                lastUpdateTime = currentTime;// ʱ
+        bool ready() const {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            return state->done;
+        }
+
+        bool wait() {
+            std::unique_lock<std::mutex> lock(state->mutex);
+            state->cond.wait(lock, [this] { return state->done; });
+            return state->durable;
+        }
+
+        // ʱؿգ wait() ͬtrue ʾ̣false ʾֻдûͬɹ
+        template<class Rep, class Period>
+        std::optional<bool> waitFor(std::chrono::duration<Rep, Period> timeout) {
+            std::unique_lock<std::mutex> lock(state->mutex);
+            if (!state->cond.wait_for(lock, timeout, [this] { return state->done; })) return std::nullopt;
+            return state->durable;
+        }
+
+        // Э̳߳лָռдߣ̳߳ûй߳ʱר߳лָ
+        bool await_ready() const { return ready(); }
+        bool await_suspend(std::coroutine_handle<> handle) {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (state->done) return false;
+            state->continuation = handle;
+            return true;
+        }
+        bool await_resume() const {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            return state->durable;
+        }
+
+    private:
+        State *state;
+    };
+
+    // ̳߳شСΪ 0 ʱָȴ־ûȷϵЭ̵̣߳һҪʱŴ
+    // Э̲дߣ̨̻߳ writerMutex ͬд̣߳ϻָܵ flush() ȴһȷϣЩҪд߼
+    class ContinuationThread {
+    public:
+        ~ContinuationThread() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
             }
-            PebbleLog::setLogName(std::move(PebbleLog::getLogName() + "[" + timeStr + "]"));
-            PebbleLog::setTimeFormat(formatStr);
+            cond.notify_one();
+            if (thread.joinable()) thread.join();
+        }
+
+        void post(std::coroutine_handle<> handle) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!thread.joinable()) thread = std::thread(&ContinuationThread::run, this);
+                handles.push_back(handle);
+            }
+            cond.notify_one();
         }
 
     private:
-        std::string formatStr;
-        std::string timeStr;
-        bool timeStrInitialized = false;// ʱǷѳʼ
-        std::time_t lastUpdateTime = 0; // ¼ϴθʱʱ
+        void run() {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true) {
+                cond.wait(lock, [this] { return stopping || !handles.empty(); });
+                if (handles.empty()) return;// ˳ǰָʣЭ
+                std::coroutine_handle<> handle = handles.front();
+                handles.pop_front();
+                lock.unlock();
+                handle.resume();
+                lock.lock();
+            }
+        }
+
+        std::mutex mutex;
+        std::condition_variable cond;
+        std::deque<std::coroutine_handle<>> handles;
+        bool stopping = false;
+        std::thread thread;
     };
 
-    class DailyLogMiddleware : public LoggerMiddleware<DailyLogMiddleware> {
+    // ־ָĿ
+    struct LogMetrics {
+        static constexpr size_t kLevelCount = 6;
+        static constexpr size_t kLatencyBuckets = 40;//  i Ͱͳ [2^(i-1), 2^i) 
+
+        std::array<uint64_t, kLevelCount> enqueued{};// ͳƵӼ¼
+        std::array<uint64_t, kLevelCount> written{}; // ͳƵд¼
+        uint64_t bytesWritten = 0;
+        uint64_t queueDepth = 0;
+        uint64_t maxQueueDepth = 0;
+        uint64_t dropped = 0;
+        std::array<uint64_t, kLevelCount> shed{};// Ӧļ¼ͳ
+        uint64_t rotations = 0;
+        uint64_t syncs = 0;            // durable()  fdatasync ͬһֻͬһ
+        uint64_t bufferAllocations = 0;// ¼δж·Ĵ
+        std::array<uint64_t, kLatencyBuckets> enqueueLatency{};// ߵ log() ĺʱͳ
+        std::array<uint64_t, kLatencyBuckets> writeLatency{};  // ̨ÿ write ϵͳõĺʱ
+
+        uint64_t totalEnqueued() const { return sum(enqueued); }
+        uint64_t totalWritten() const { return sum(written); }
+        uint64_t totalShed() const { return sum(shed); }
+
+        // ֱͼаٷλ p0~1ͰϽ磬λ
+        static uint64_t percentile(const std::array<uint64_t, kLatencyBuckets> &histogram, double p) {
+            uint64_t total = sum(histogram);
+            if (total == 0) return 0;
+            uint64_t rank = static_cast<uint64_t>(p * static_cast<double>(total - 1)) + 1;
+            uint64_t seen = 0;
+            for (size_t i = 0; i < kLatencyBuckets; ++i) {
+                seen += histogram[i];
+                if (seen >= rank) return uint64_t(1) << i;
+            }
+            return uint64_t(1) << (kLatencyBuckets - 1);
+        }
+
+        std::string toString() const {
+            return std::format("metrics: enqueued={} written={} bytes={} queue={}/{} dropped={} shed={} rotations={} syncs={} allocations={} "
+                               "enqueue_ns(p50/p99/p999)={}/{}/{} write_ns(p50/p99/p999)={}/{}/{}",
+                               totalEnqueued(), totalWritten(), bytesWritten, queueDepth, maxQueueDepth, dropped, totalShed(), rotations, syncs,
+                               bufferAllocations,
+                               percentile(enqueueLatency, 0.5), percentile(enqueueLatency, 0.99), percentile(enqueueLatency, 0.999),
+                               percentile(writeLatency, 0.5), percentile(writeLatency, 0.99), percentile(writeLatency, 0.999));
+        }
+
+    private:
+        template<size_t N>
+        static uint64_t sum(const std::array<uint64_t, N> &values) {
+            uint64_t total = 0;
+            for (uint64_t value: values) total += value;
+            return total;
+        }
+    };
+
+    // ָɼ߼̷߳Ƭ߳ͬһУֻ̨һдߣȫʹ relaxed ԭӲ
+    class MetricsCollector {
     public:
-        DailyLogMiddleware() {}
+        static constexpr size_t kShardCount = 16;
+        static constexpr uint32_t kSampleMask = 15;// ÿ 16 εóһӳ
 
-        void process() {
-            std::lock_guard<std::mutex> lock(PebbleLog::getMutex());
-            std::string dateStr = getLocalTimeString("%Y-%m-%d");
-            std::string logName = PebbleLog::getLogName();
-            size_t dotPos = logName.find_last_of('.');
-            if (dotPos != std::string::npos) {
-                // ļв
-                std::string newLogName = logName.substr(0, dotPos) + "_" + dateStr + logName.substr(dotPos);
-                PebbleLog::setLogName(newLogName);
-            } else {
-                // ûչֱļ
-                PebbleLog::setLogName(logName + "_" + dateStr);
+        static size_t bucketOf(uint64_t nanoseconds) {
+            return std::min<size_t>(std::bit_width(nanoseconds), LogMetrics::kLatencyBuckets - 1);
+        }
+
+        // ǰ̱߳εǷҪʱ
+        static bool sampleThisCall() {
+            static thread_local uint32_t counter = 0;
+            return (++counter & kSampleMask) == 0;
+        }
+
+        void recordEnqueue(LogLevel level) {
+            localShard().enqueued[static_cast<size_t>(level)].fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void recordEnqueueLatency(uint64_t latencyNs) {
+            localShard().enqueueLatency[bucketOf(latencyNs)].fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void recordDropped(uint64_t count = 1) { dropped.fetch_add(count, std::memory_order_relaxed); }
+
+        void recordShed(LogLevel level) {
+            localShard().shed[static_cast<size_t>(level)].fetch_add(1, std::memory_order_relaxed);
+        }
+
+        std::array<uint64_t, LogMetrics::kLevelCount> shedCounts() const {
+            std::array<uint64_t, LogMetrics::kLevelCount> counts{};
+            for (const Shard &shard: shards) {
+                for (size_t i = 0; i < LogMetrics::kLevelCount; ++i) counts[i] += shard.shed[i].load(std::memory_order_relaxed);
+            }
+            return counts;
+        }
+
+        // ֻɺ̵̨߳
+        void recordDequeued(uint64_t count) {
+            add(dequeued, count);
+            if (count > maxQueueDepth.load(std::memory_order_relaxed)) maxQueueDepth.store(count, std::memory_order_relaxed);
+        }
+        void recordWritten(LogLevel level) { add(written[static_cast<size_t>(level)], 1); }
+        void recordWrite(uint64_t bytes, uint64_t latencyNs) {
+            add(bytesWritten, bytes);
+            add(writeLatency[bucketOf(latencyNs)], 1);
+        }
+        void recordRotation() { add(rotations, 1); }
+        void recordSync() { add(syncs, 1); }
+
+        LogMetrics snapshot() const {
+            LogMetrics metrics;
+            for (const Shard &shard: shards) {
+                for (size_t i = 0; i < LogMetrics::kLevelCount; ++i) {
+                    metrics.enqueued[i] += shard.enqueued[i].load(std::memory_order_relaxed);
+                }
+                for (size_t i = 0; i < LogMetrics::kLatencyBuckets; ++i) {
+                    metrics.enqueueLatency[i] += shard.enqueueLatency[i].load(std::memory_order_relaxed);
+                }
+            }
+            for (size_t i = 0; i < LogMetrics::kLevelCount; ++i) {
+                metrics.written[i] = written[i].load(std::memory_order_relaxed);
+            }
+            for (size_t i = 0; i < LogMetrics::kLatencyBuckets; ++i) {
+                metrics.writeLatency[i] = writeLatency[i].load(std::memory_order_relaxed);
+            }
+            uint64_t total = metrics.totalEnqueued();
+            uint64_t done = dequeued.load(std::memory_order_relaxed);
+            metrics.queueDepth = total > done ? total - done : 0;
+            metrics.maxQueueDepth = maxQueueDepth.load(std::memory_order_relaxed);
+            metrics.bytesWritten = bytesWritten.load(std::memory_order_relaxed);
+            metrics.dropped = dropped.load(std::memory_order_relaxed);
+            metrics.shed = shedCounts();
+            metrics.rotations = rotations.load(std::memory_order_relaxed);
+            metrics.syncs = syncs.load(std::memory_order_relaxed);
+            return metrics;
+        }
+
+    private:
+        struct alignas(64) Shard {
+            std::atomic<uint64_t> enqueued[LogMetrics::kLevelCount] = {};
+            std::atomic<uint64_t> enqueueLatency[LogMetrics::kLatencyBuckets] = {};
+            std::atomic<uint64_t> shed[LogMetrics::kLevelCount] = {};
+        };
+
+        // ߳Ƭʱ̹߳һƬдҲͬʱԺ̨̺߳д̨̳̣߳߳ԭӼ
+        static void add(std::atomic<uint64_t> &counter, uint64_t value) { counter.fetch_add(value, std::memory_order_relaxed); }
+
+        Shard &localShard() {
+            static thread_local size_t index = nextShard.fetch_add(1, std::memory_order_relaxed) % kShardCount;
+            return shards[index];
+        }
+
+        Shard shards[kShardCount];
+        std::atomic<size_t> nextShard{0};
+        alignas(64) std::atomic<uint64_t> dequeued{0};
+        std::atomic<uint64_t> maxQueueDepth{0};
+        std::atomic<uint64_t> written[LogMetrics::kLevelCount] = {};
+        std::atomic<uint64_t> bytesWritten{0};
+        std::atomic<uint64_t> writeLatency[LogMetrics::kLatencyBuckets] = {};
+        std::atomic<uint64_t> rotations{0};
+        std::atomic<uint64_t> syncs{0};
+        alignas(64) std::atomic<uint64_t> dropped{0};
+    };
+
+    // ӦĿֻȡЧͼ״ֻ̬ɺ̨߳ÿȡһ¼
+    class LoadShedder {
+    public:
+        // һν̵Ļܣڻָʱ
+        struct Episode {
+            std::chrono::milliseconds duration{0};
+            size_t peakBacklog = 0;
+            LogLevel peakLevel = LogLevel::DEBUG;// ߼
+            std::array<uint64_t, LogMetrics::kLevelCount> shed{};
+
+            std::string toString() const {
+                static constexpr std::string_view names[] = {"DEBUG", "INFO", "WARN", "ERROR", "FATAL", "TRACE"};
+                std::string text = std::format("load shedding ended after {} ms: peak backlog {}, dropped up to {}", duration.count(), peakBacklog,
+                                               names[static_cast<size_t>(peakLevel)]);
+                for (size_t i = 0; i < shed.size(); ++i) {
+                    if (shed[i] > 0) text += std::format(" {}={}", names[i], shed[i]);
+                }
+                return text;
+            }
+        };
+
+        // ߵãǰǷüļ¼
+        bool sheds(LogLevel level) const {
+            int minimum = minimumLevel.load(std::memory_order_relaxed);
+            return minimum > 0 && level != LogLevel::ERROR && level != LogLevel::FATAL &&
+                   (level == LogLevel::TRACE || static_cast<int>(level) < minimum);
+        }
+
+        bool active() const { return step > 0; }
+
+        // backlog Ϊȡļ¼һڼѹ̽ʱػ
+        std::optional<Episode> update(const LoadSheddingPolicy &policy, size_t backlog, std::chrono::steady_clock::time_point now,
+                                      const MetricsCollector &metrics) {
+            if (!policy.enabled()) {
+                if (step == 0) return std::nullopt;
+                return finish(now, metrics);
+            }
+            int maxStep = policy.maxLevel == LogLevel::TRACE ? 1 : std::min(static_cast<int>(policy.maxLevel) + 1, 3);
+            bool growing = backlog >= previousBacklog;
+            previousBacklog = backlog;
+            if (step > 0) episode.peakBacklog = std::max(episode.peakBacklog, backlog);
+
+            if (step < maxStep && growing && backlog >= (policy.highWatermark << step)) {
+                if (step == 0) {
+                    started = now;
+                    shedAtStart = metrics.shedCounts();
+                    episode = {};
+                    episode.peakBacklog = backlog;
+                }
+                setStep(step + 1);
+                calmSince = now;
+                return std::nullopt;
+            }
+            if (step == 0) return std::nullopt;
+            // ѹ¼ʱָҪƽ holdTime
+            if (backlog > policy.lowWatermark) {
+                calmSince = now;
+                return std::nullopt;
+            }
+            if (now - calmSince < policy.holdTime) return std::nullopt;
+            calmSince = now;
+            if (step > 1) {
+                setStep(step - 1);
+                return std::nullopt;
+            }
+            return finish(now, metrics);
+        }
+
+    private:
+        void setStep(int next) {
+            step = next;
+            if (step > 0) episode.peakLevel = std::max(episode.peakLevel, static_cast<LogLevel>(step - 1));
+            minimumLevel.store(step, std::memory_order_relaxed);
+        }
+
+        Episode finish(std::chrono::steady_clock::time_point now, const MetricsCollector &metrics) {
+            setStep(0);
+            previousBacklog = 0;
+            episode.duration = std::chrono::duration_cast<std::chrono::milliseconds>(now - started);
+            std::array<uint64_t, LogMetrics::kLevelCount> total = metrics.shedCounts();
+            for (size_t i = 0; i < total.size(); ++i) episode.shed[i] = total[i] - shedAtStart[i];
+            return episode;
+        }
+
+        std::atomic<int> minimumLevel{0};// 0 ʾn ʾڵ n ļ¼
+        int step = 0;
+        size_t previousBacklog = 0;
+        std::chrono::steady_clock::time_point started;
+        std::chrono::steady_clock::time_point calmSince;
+        std::array<uint64_t, LogMetrics::kLevelCount> shedAtStart{};
+        Episode episode;
+    };
+
+    // ʱĲɼ뻻㣺ֻȡһԭʼ̨У׼Ϊǽʱ
+    class TimestampClock {
+    public:
+        enum Kind : uint8_t {
+            REALTIME,// ϵͳʱ軻
+            TSC,     // rdtsc 
+            COARSE   // CLOCK_MONOTONIC_COARSE 
+        };
+
+        struct Stamp {
+            uint64_t ticks = 0;
+            Kind kind = REALTIME;
+        };
+
+        // ĸ̨ÿȡһΣߵǼǱʱҲȡʱټ
+        struct Calibration {
+            uint64_t baseTicks = 0;
+            int64_t baseWall = 0;
+            double nsPerTick = 1.0;
+            int64_t coarseOffset = 0;// ǽʱ뵥ʱ֮
+
+            int64_t toWallNanos(const Stamp &stamp) const {
+                switch (stamp.kind) {
+                    case TSC: return baseWall + static_cast<int64_t>(static_cast<double>(static_cast<int64_t>(stamp.ticks - baseTicks)) * nsPerTick);
+                    case COARSE: return static_cast<int64_t>(stamp.ticks) + coarseOffset;
+                    default: return static_cast<int64_t>(stamp.ticks);
+                }
+            }
+        };
+
+        static constexpr std::chrono::milliseconds kRecalibrateInterval{1000};
+
+        Stamp now() const {
+            Kind current = kind.load(std::memory_order_relaxed);
+            return {read(current), current};
+        }
+
+        // CPU  TSC Ƶʺ㶨Ҳֹͣʱʹ rdtsc
+        static bool invariantTscSupported() {
+#if defined(PEBBLELOG_HAS_RDTSC) && defined(_MSC_VER)
+            int regs[4];
+            __cpuid(regs, 0x80000000);
+            if (static_cast<unsigned>(regs[0]) < 0x80000007u) return false;
+            __cpuid(regs, 0x80000007);
+            return (regs[3] & (1 << 8)) != 0;
+#elif defined(PEBBLELOG_HAS_RDTSC)
+            unsigned eax, ebx, ecx, edx;
+            if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx)) return false;
+            return (edx & (1u << 8)) != 0;
+#else
+            return false;
+#endif
+        }
+
+        // лʱԴTSC ʱ˻ COARSE״ʹ TSC ʱԼ 10ms Ƶʣȴڼ䲻Ӱ̨У׼
+        void select(TimestampSource source) {
+            Kind next = REALTIME;
+            if (source == TimestampSource::TSC) next = invariantTscSupported() ? TSC : COARSE;
+            if (next != REALTIME) {
+                bool anchored;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    anchored = anchorWall != 0;
+                }
+                uint64_t ticks = 0;
+                int64_t wall = 0;
+                if (next == TSC && !anchored) {
+                    sampleTsc(ticks, wall);
+                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                }
+                std::lock_guard<std::mutex> lock(mutex);
+                if (wall != 0 && anchorWall == 0) {
+                    anchorTicks = ticks;
+                    anchorWall = wall;
+                }
+                recalibrateLocked();
+            }
+            kind.store(next, std::memory_order_relaxed);
+        }
+
+        // ɺ̨ڵã״βΪƵʣԱβΪµĻ㣬Ưƺϵͳʱ
+        void recalibrate() {
+            if (kind.load(std::memory_order_relaxed) == REALTIME) return;
+            std::lock_guard<std::mutex> lock(mutex);
+            recalibrateLocked();
+        }
+
+        //  seqlock ȡһηĲУ׼
+        Calibration calibration() const {
+            while (true) {
+                uint64_t before = version.load(std::memory_order_acquire);
+                if ((before & 1) == 0) {
+                    Calibration copy;
+                    copy.baseTicks = published.baseTicks.load(std::memory_order_relaxed);
+                    copy.baseWall = published.baseWall.load(std::memory_order_relaxed);
+                    copy.nsPerTick = published.nsPerTick.load(std::memory_order_relaxed);
+                    copy.coarseOffset = published.coarseOffset.load(std::memory_order_relaxed);
+                    std::atomic_thread_fence(std::memory_order_acquire);
+                    if (version.load(std::memory_order_relaxed) == before) return copy;
+                }
+                std::this_thread::yield();
+            }
+        }
+
+        static int64_t realtimeNanos() {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        }
+
+    private:
+        static uint64_t read(Kind kind) {
+            switch (kind) {
+#ifdef PEBBLELOG_HAS_RDTSC
+                case TSC: return __rdtsc();
+#endif
+                case COARSE: {
+#ifdef CLOCK_MONOTONIC_COARSE
+                    timespec ts;
+                    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+                    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec);
+#else
+                    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+                }
+                default: return static_cast<uint64_t>(realtimeNanos());
+            }
+        }
+
+        // ǰζȡ TSC ȡе㣬Сȡϵͳʱ䱾
+        static void sampleTsc(uint64_t &ticks, int64_t &wall) {
+            uint64_t before = read(TSC);
+            wall = realtimeNanos();
+            uint64_t after = read(TSC);
+            ticks = before + (after - before) / 2;
+        }
+
+        void recalibrateLocked() {
+            current.coarseOffset = realtimeNanos() - static_cast<int64_t>(read(COARSE));
+            if (anchorWall == 0) {
+                publishLocked();
+                return;
+            }
+            uint64_t ticks;
+            int64_t wall;
+            sampleTsc(ticks, wall);
+            if (ticks > anchorTicks && wall > anchorWall) {
+                current.nsPerTick = static_cast<double>(wall - anchorWall) / static_cast<double>(ticks - anchorTicks);
+            }
+            current.baseTicks = ticks;
+            current.baseWall = wall;
+            publishLocked();
+        }
+
+        void publishLocked() {
+            version.fetch_add(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            published.baseTicks.store(current.baseTicks, std::memory_order_relaxed);
+            published.baseWall.store(current.baseWall, std::memory_order_relaxed);
+            published.nsPerTick.store(current.nsPerTick, std::memory_order_relaxed);
+            published.coarseOffset.store(current.coarseOffset, std::memory_order_relaxed);
+            version.fetch_add(1, std::memory_order_release);
+        }
+
+        struct PublishedCalibration {
+            std::atomic<uint64_t> baseTicks{0};
+            std::atomic<int64_t> baseWall{0};
+            std::atomic<double> nsPerTick{1.0};
+            std::atomic<int64_t> coarseOffset{0};
+        };
+
+        std::atomic<Kind> kind{REALTIME};
+        mutable std::mutex mutex;// У׼̣ȡ
+        uint64_t anchorTicks = 0;
+        int64_t anchorWall = 0;
+        Calibration current;
+        std::atomic<uint64_t> version{0};// ʾڷ
+        PublishedCalibration published;
+    };
+
+    // ݻλ壬ÿ߳һݣ˵־ڱ̵߳Ļб漶ʱϢģ
+    // ʱǰ׺ȵʱŸʽ̼߳¼ ERROR  FATAL ʱֻԼ
+    class BacktraceRing {
+    public:
+        struct Entry {
+            LogLevel level = LogLevel::DEBUG;
+            TimestampClock::Stamp stamp;
+            uint64_t threadId = 0;
+            std::string message;// ȶٷ
+        };
+
+        // ̵߳Ļ´ʹʱµĴСؽ֮ǰݶ
+        void resize(size_t capacity) {
+            this->capacity.store(capacity, std::memory_order_relaxed);
+            generation.fetch_add(1, std::memory_order_release);
+        }
+
+        bool isEnabled() const { return capacity.load(std::memory_order_relaxed) > 0; }
+
+        void push(LogLevel level, TimestampClock::Stamp stamp, uint64_t threadId, std::string_view formatStr, std::format_args args) {
+            Local &local = current();
+            if (local.entries.empty()) return;
+            Entry &entry = local.next(level, stamp, threadId);
+            std::vformat_to(std::back_inserter(entry.message), formatStr, args);
+        }
+
+        void push(LogLevel level, TimestampClock::Stamp stamp, uint64_t threadId, std::string_view message) {
+            Local &local = current();
+            if (local.entries.empty()) return;
+            local.next(level, stamp, threadId).message.append(message);
+        }
+
+        // д˳յǰ̵߳Ļ
+        template<typename Func>
+        void drain(Func &&func) {
+            Local &local = current();
+            size_t start = (local.head + local.entries.size() - local.count) % (local.entries.empty() ? 1 : local.entries.size());
+            for (size_t i = 0; i < local.count; ++i) {
+                func(local.entries[(start + i) % local.entries.size()]);
+            }
+            local.count = 0;
+        }
+
+    private:
+        struct Local {
+            std::vector<Entry> entries;
+            size_t head = 0;
+            size_t count = 0;
+            uint64_t generation = 0;
+
+            Entry &next(LogLevel level, TimestampClock::Stamp stamp, uint64_t threadId) {
+                Entry &entry = entries[head];
+                entry.level = level;
+                entry.stamp = stamp;
+                entry.threadId = threadId;
+                entry.message.clear();
+                head = (head + 1) % entries.size();
+                if (count < entries.size()) ++count;
+                return entry;
+            }
+        };
+
+        // ֻһʵ߳˽еĻںڵ thread_local 
+        Local &current() {
+            static thread_local Local local;
+            uint64_t latest = generation.load(std::memory_order_acquire);
+            if (local.generation != latest) {
+                local.entries.clear();
+                local.entries.resize(capacity.load(std::memory_order_relaxed));
+                local.entries.shrink_to_fit();
+                local.head = 0;
+                local.count = 0;
+                local.generation = latest;
             }
+            return local;
+        }
+
+        std::atomic<size_t> capacity{0};
+        std::atomic<uint64_t> generation{0};
+    };
+
+    // д¼ľ񣺲λ̶Ԥȷ䣬ʱźŴ޷ر
+    class PendingRecordRing {
+    public:
+        static constexpr size_t kDefaultSlotCount = 1024;
+        static constexpr size_t kSlotSize = 512;// ڱʱض
+
+        enum SlotState : uint8_t {
+            EMPTY,
+            FILLING,
+            PENDING,// ӣδд
+            WRITING,// ̨д
+            DRAINED // ɱ·д
+        };
+
+        // ֻǰ֮·
+        void enable(size_t capacity) {
+            if (!slots) {
+                slotCount = capacity > 0 ? capacity : kDefaultSlotCount;
+                slots = std::make_unique<Slot[]>(slotCount);
+            }
+            enabled.store(true, std::memory_order_release);
+        }
+
+        void disable() { enabled.store(false, std::memory_order_release); }
+
+        bool isEnabled() const { return enabled.load(std::memory_order_acquire); }
+
+        // ǼһѸʽļ¼Ʊݣ0 ʾδǼ
+        uint64_t track(std::string_view message) {
+            if (!isEnabled()) return 0;
+            uint64_t seq = head.fetch_add(1, std::memory_order_relaxed);
+            Slot &slot = slots[seq % slotCount];
+            uint8_t state = slot.state.load(std::memory_order_relaxed);
+            // λһռʱǼǣ¼첽
+            if (state == FILLING || !slot.state.compare_exchange_strong(state, FILLING, std::memory_order_acquire)) {
+                return 0;
+            }
+            // ĩβϻУʱһ write дУ̨д뽻
+            size_t length = std::min(message.size(), kSlotSize - 1);
+            std::memcpy(slot.data, message.data(), length);
+            slot.data[length] = '\n';
+            slot.length = static_cast<uint32_t>(length + 1);
+            slot.seq.store(seq, std::memory_order_relaxed);
+            slot.state.store(PENDING, std::memory_order_release);
+            return seq + 1;
+        }
+
+        // ̨дǰã¼ѱ·дʱ false
+        bool beginWrite(uint64_t ticket) {
+            if (ticket == 0) return true;
+            Slot &slot = slots[(ticket - 1) % slotCount];
+            if (slot.seq.load(std::memory_order_relaxed) != ticket - 1) return true;
+            uint8_t expected = PENDING;
+            if (slot.state.compare_exchange_strong(expected, WRITING, std::memory_order_acq_rel)) return true;
+            return expected != DRAINED;
+        }
+
+        void endWrite(uint64_t ticket) {
+            if (ticket == 0) return;
+            Slot &slot = slots[(ticket - 1) % slotCount];
+            if (slot.seq.load(std::memory_order_relaxed) != ticket - 1) return;
+            uint8_t expected = WRITING;
+            slot.state.compare_exchange_strong(expected, EMPTY, std::memory_order_release);
+        }
+
+        // ˳δдļ¼ֻʹԭӲźŴе
+        template<typename Func>
+        void drain(bool includeInFlight, Func &&func) {
+            if (!isEnabled()) return;
+            uint64_t end = head.load(std::memory_order_acquire);
+            uint64_t begin = end > slotCount ? end - slotCount : 0;
+            for (uint64_t seq = begin; seq < end; ++seq) {
+                Slot &slot = slots[seq % slotCount];
+                uint8_t state = slot.state.load(std::memory_order_acquire);
+                if (slot.seq.load(std::memory_order_relaxed) != seq) continue;
+                if (state != PENDING && !(includeInFlight && state == WRITING)) continue;
+                if (!slot.state.compare_exchange_strong(state, DRAINED, std::memory_order_acq_rel)) continue;
+                func(slot.data, slot.length);
+            }
+        }
+
+    private:
+        struct Slot {
+            std::atomic<uint64_t> seq{0};
+            std::atomic<uint8_t> state{EMPTY};
+            uint32_t length = 0;
+            char data[kSlotSize];
+        };
+
+        std::unique_ptr<Slot[]> slots;
+        size_t slotCount = kDefaultSlotCount;
+        std::atomic<uint64_t> head{0};
+        std::atomic<bool> enabled{false};
+    };
+
+    // ڴ滷 N Ѹʽļ¼ӿڡԺ͵Խȡ
+    // ֻк̨߳д룻ͨÿλУԣд뷽Ӳȴ
+    class MemorySink {
+    public:
+        static constexpr size_t kSlotSize = 512;// ֽض
+
+        struct Record {
+            uint64_t seq;//  0 ʼȫ
+            LogLevel level;
+            std::string message;
+        };
+
+        // ߣӶʱ̿ʼȡ¼¼̫ǵļ¼ missed()
+        class Subscription {
+        public:
+            explicit Subscription(const MemorySink &sink) : sink(&sink), cursor(sink.published.load(std::memory_order_acquire)) {}
+
+            // ضȡ¼¼ض
+            template<typename Func>
+            size_t poll(Func &&func) {
+                size_t count = 0;
+                Record record;
+                uint64_t end = sink->published.load(std::memory_order_acquire);
+                while (cursor < end) {
+                    if (end - cursor > sink->capacity) {
+                        lost += end - cursor - sink->capacity;
+                        cursor = end - sink->capacity;
+                    }
+                    if (sink->read(cursor, record)) {
+                        func(record);
+                        ++count;
+                    } else {
+                        ++lost;// ȡб
+                    }
+                    ++cursor;
+                }
+                return count;
+            }
+
+            // ֱ¼¼
+            void wait() const { sink->published.wait(cursor, std::memory_order_acquire); }
+
+            uint64_t missed() const { return lost; }
+
+        private:
+            const MemorySink *sink;
+            uint64_t cursor;
+            uint64_t lost = 0;
+        };
+
+        explicit MemorySink(size_t capacity) : capacity(std::max<size_t>(capacity, 1)),
+                                               slots(std::make_unique<Slot[]>(this->capacity)) {}
+
+        // ɺ̵̨߳
+        void write(LogLevel level, std::string_view prefix, std::string_view message, std::string_view suffix = {}) {
+            uint64_t seq = published.load(std::memory_order_relaxed);
+            Slot &slot = slots[seq % capacity];
+            slot.version.store(seq * 2 + 1, std::memory_order_relaxed);// ʾд
+            std::atomic_thread_fence(std::memory_order_release);
+            size_t prefixLength = std::min(prefix.size(), kSlotSize);
+            size_t length = std::min(message.size(), kSlotSize - prefixLength);
+            size_t suffixLength = std::min(suffix.size(), kSlotSize - prefixLength - length);
+            std::memcpy(slot.data, prefix.data(), prefixLength);
+            std::memcpy(slot.data + prefixLength, message.data(), length);
+            std::memcpy(slot.data + prefixLength + length, suffix.data(), suffixLength);
+            slot.length = static_cast<uint32_t>(prefixLength + length + suffixLength);
+            slot.level = level;
+            slot.version.store(seq * 2 + 2, std::memory_order_release);
+            published.store(seq + 1, std::memory_order_release);
+            published.notify_all();
+        }
+
+        // ǰԱڻеļ¼Ŀ
+        std::vector<Record> snapshot() const {
+            std::vector<Record> records;
+            uint64_t end = published.load(std::memory_order_acquire);
+            uint64_t begin = end > capacity ? end - capacity : 0;
+            records.reserve(end - begin);
+            Record record;
+            for (uint64_t seq = begin; seq < end; ++seq) {
+                if (read(seq, record)) records.push_back(std::move(record));
+            }
+            return records;
+        }
+
+        Subscription subscribe() const { return Subscription(*this); }
+
+        uint64_t totalWritten() const { return published.load(std::memory_order_acquire); }
+
+    private:
+        struct Slot {
+            std::atomic<uint64_t> version{0};// д seq Ϊ seq * 2 + 2
+            LogLevel level = LogLevel::DEBUG;
+            uint32_t length = 0;
+            char data[kSlotSize];
+        };
+
+        bool read(uint64_t seq, Record &record) const {
+            const Slot &slot = slots[seq % capacity];
+            uint64_t before = slot.version.load(std::memory_order_acquire);
+            if (before != seq * 2 + 2) return false;
+            uint32_t length = std::min<uint32_t>(slot.length, kSlotSize);
+            record.seq = seq;
+            record.level = slot.level;
+            record.message.assign(slot.data, length);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return slot.version.load(std::memory_order_relaxed) == before;// 汾仯˵Ĺб
+        }
+
+        const size_t capacity;
+        std::unique_ptr<Slot[]> slots;
+        std::atomic<uint64_t> published{0};
+    };
+
+    // ¼أּ std::stringȡą́д黹ȶкٵ malloc/free
+    // ÿ߳ԼĻ棬ֻлȡջʱ빲ֿ⽻һμ kTransferCount 
+    class RecordBufferPool {
+    public:
+        static constexpr size_t kClassSizes[] = {128, 512, 2048, 8192};
+        static constexpr size_t kClassCount = std::size(kClassSizes);
+        static constexpr size_t kTransferCount = 32;           // ֿ̻߳ÿν
+        static constexpr size_t kLocalLimit = 2 * kTransferCount;// ߳ÿ໺
+        static constexpr size_t kDepotLimit = 4096;             // ֿÿౣֱͷ
+
+        // ȡһС sizeHint Ŀջ壻ּʱ
+        std::string acquire(size_t sizeHint) {
+            size_t cls = classOf(sizeHint);
+            if (cls < kClassCount) {
+                LocalCache &cache = localCache();
+                for (size_t i = cls; i < kClassCount; ++i) {
+                    if (cache.buffers[i].empty()) refill(cache, i);
+                    if (!cache.buffers[i].empty()) {
+                        std::string buffer = std::move(cache.buffers[i].back());
+                        cache.buffers[i].pop_back();
+                        return buffer;
+                    }
+                }
+            }
+            allocations.fetch_add(1, std::memory_order_relaxed);
+            std::string buffer;
+            buffer.reserve(cls < kClassCount ? kClassSizes[cls] : sizeHint);
+            return buffer;
+        }
+
+        // 黹壬ʵּСֱͷ
+        void release(std::string &&buffer) {
+            size_t capacity = buffer.capacity();
+            if (capacity < kClassSizes[0] || capacity > 4 * kClassSizes[kClassCount - 1]) return;
+            size_t cls = kClassCount - 1;
+            while (kClassSizes[cls] > capacity) --cls;
+            buffer.clear();
+            LocalCache &cache = localCache();
+            if (cache.buffers[cls].size() >= kLocalLimit) spill(cache, cls);
+            cache.buffers[cls].push_back(std::move(buffer));
+        }
+
+        // 򻺴δж·ĻȶкӦ
+        uint64_t allocationCount() const { return allocations.load(std::memory_order_relaxed); }
+
+    private:
+        struct LocalCache {
+            explicit LocalCache(RecordBufferPool &pool) : pool(pool) {
+                for (auto &buffers: this->buffers) buffers.reserve(kLocalLimit);
+            }
+            // ߳˳ʱѻĻ彻ֿ
+            ~LocalCache() {
+                for (size_t i = 0; i < kClassCount; ++i) {
+                    while (!buffers[i].empty()) pool.spill(*this, i);
+                }
+            }
+
+            RecordBufferPool &pool;
+            std::vector<std::string> buffers[kClassCount];
+        };
+
+        struct Depot {
+            std::mutex mutex;
+            std::vector<std::string> buffers;
+        };
+
+        static size_t classOf(size_t size) {
+            for (size_t i = 0; i < kClassCount; ++i) {
+                if (size <= kClassSizes[i]) return i;
+            }
+            return kClassCount;
+        }
+
+        LocalCache &localCache() {
+            static thread_local LocalCache cache(*this);
+            return cache;
+        }
+
+        void refill(LocalCache &cache, size_t cls) {
+            Depot &depot = depots[cls];
+            std::lock_guard<std::mutex> lock(depot.mutex);
+            size_t count = std::min(kTransferCount, depot.buffers.size());
+            for (size_t i = 0; i < count; ++i) {
+                cache.buffers[cls].push_back(std::move(depot.buffers.back()));
+                depot.buffers.pop_back();
+            }
+        }
+
+        void spill(LocalCache &cache, size_t cls) {
+            Depot &depot = depots[cls];
+            std::lock_guard<std::mutex> lock(depot.mutex);
+            if (depot.buffers.capacity() == 0) depot.buffers.reserve(kDepotLimit);
+            size_t count = std::min(kTransferCount, cache.buffers[cls].size());
+            for (size_t i = 0; i < count; ++i) {
+                if (depot.buffers.size() < kDepotLimit) depot.buffers.push_back(std::move(cache.buffers[cls].back()));
+                cache.buffers[cls].pop_back();
+            }
+        }
+
+        Depot depots[kClassCount];
+        std::atomic<uint64_t> allocations{0};
+    };
+
+    // һá޸ģ޸ʱһݸĺú滻
+    struct LogConfig {
+        LogLevel level = LogLevel::DEBUG;
+        LogType type = LogType::CONSOLE;
+        size_t maxFileSize = 10 * 1024 * 1024;// Ĭ 10MB
+        size_t maxFileCount = 5;
+        std::string logPath = "./logs";
+        std::string logName = "app.log";
+        std::string timeFormat = "%Y-%m-%d %H:%M:%S";// Ĭʱʽ
+        std::string prefixFormat;                     // ʱ֮󡢼֮ǰĹ̶ǰ׺
+        std::string pattern;                          // ʽΪʱʹĬϲ֣ PatternFormatter
+        OutputFormat outputFormat = OutputFormat::TEXT;
+        FileIndexPolicy fileIndex;                    // ļϡĬϹر
+        FileCompressionPolicy compression;            // ļʽѹĬϹر
+        FileIoPolicy fileIo;                          // ļд뷽ʽĬϾҳ
+    };
+
+    // Ϣĵת塣ָÿμ 16/32 ֽڣҵһҪתλã
+    // ֮ǰĸɾƬθƣx86 ʱ CPU ֧ѡ AVX2  SSE2ƽֽ̨ڼ
+    namespace escape {
+        enum class Mode : uint8_t {
+            NONE,
+            SINGLE_LINE,// ַƱ⣩ DEL ת \n\r\xHH֤һ¼ֻռһУ'\' Ҳת壬ת
+            JSON        // JSON ַת '"'  '\'ַʹ \uXXXX
+        };
+
+        inline bool needsEscape(unsigned char c, Mode mode) {
+            if (mode == Mode::JSON) return c < 0x20 || c == '"' || c == '\\';
+            return (c < 0x20 && c != '\t') || c == 0x7F || c == '\\';
+        }
+
+        inline size_t findScalar(const char *data, size_t size, Mode mode) {
+            for (size_t i = 0; i < size; ++i) {
+                if (needsEscape(static_cast<unsigned char>(data[i]), mode)) return i;
+            }
+            return size;
+        }
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define PEBBLELOG_HAS_SSE2
+        inline size_t findSse2(const char *data, size_t size, Mode mode) {
+            const __m128i limit = _mm_set1_epi8(0x1F);
+            const __m128i quote = _mm_set1_epi8('"');
+            const __m128i backslash = _mm_set1_epi8('\\');
+            const __m128i tab = _mm_set1_epi8('\t');
+            const __m128i del = _mm_set1_epi8(0x7F);
+            const __m128i zero = _mm_setzero_si128();
+            size_t i = 0;
+            for (; i + 16 <= size; i += 16) {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+                __m128i control = _mm_cmpeq_epi8(_mm_subs_epu8(v, limit), zero);// ޷ <= 0x1F
+                __m128i hit;
+                if (mode == Mode::JSON) {
+                    hit = _mm_or_si128(control, _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)));
+                } else {
+                    hit = _mm_or_si128(_mm_andnot_si128(_mm_cmpeq_epi8(v, tab), control), _mm_or_si128(_mm_cmpeq_epi8(v, del), _mm_cmpeq_epi8(v, backslash)));
+                }
+                if (int mask = _mm_movemask_epi8(hit)) return i + static_cast<size_t>(std::countr_zero(static_cast<unsigned>(mask)));
+            }
+            return i + findScalar(data + i, size - i, mode);
+        }
+#endif
+
+#if defined(PEBBLELOG_HAS_SSE2) && (defined(__GNUC__) || defined(__clang__))
+#define PEBBLELOG_HAS_AVX2_KERNEL
+        __attribute__((target("avx2"))) inline size_t findAvx2(const char *data, size_t size, Mode mode) {
+            const __m256i limit = _mm256_set1_epi8(0x1F);
+            const __m256i quote = _mm256_set1_epi8('"');
+            const __m256i backslash = _mm256_set1_epi8('\\');
+            const __m256i tab = _mm256_set1_epi8('\t');
+            const __m256i del = _mm256_set1_epi8(0x7F);
+            const __m256i zero = _mm256_setzero_si256();
+            size_t i = 0;
+            for (; i + 32 <= size; i += 32) {
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+                __m256i control = _mm256_cmpeq_epi8(_mm256_subs_epu8(v, limit), zero);
+                __m256i hit;
+                if (mode == Mode::JSON) {
+                    hit = _mm256_or_si256(control, _mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, backslash)));
+                } else {
+                    hit = _mm256_or_si256(_mm256_andnot_si256(_mm256_cmpeq_epi8(v, tab), control),
+                                          _mm256_or_si256(_mm256_cmpeq_epi8(v, del), _mm256_cmpeq_epi8(v, backslash)));
+                }
+                if (uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(hit))) return i + static_cast<size_t>(std::countr_zero(mask));
+            }
+            return i + findSse2(data + i, size - i, mode);
+        }
+#endif
+
+        using FindFunction = size_t (*)(const char *, size_t, Mode);
+
+        inline FindFunction selectKernel() {
+#if defined(PEBBLELOG_HAS_AVX2_KERNEL)
+            if (__builtin_cpu_supports("avx2")) return &findAvx2;
+#endif
+#if defined(PEBBLELOG_HAS_SSE2)
+            return &findSse2;
+#else
+            return &findScalar;
+#endif
+        }
+
+        // һҪתֽڵλãûʱ size
+        inline size_t find(std::string_view text, Mode mode) {
+            static const FindFunction kernel = selectKernel();
+            return kernel(text.data(), text.size(), mode);
+        }
+
+        //  text ת׷ӵ outɾƬθ
+        inline void append(std::string_view text, Mode mode, std::string &out) {
+            static constexpr char hex[] = "0123456789abcdef";
+            size_t pos = 0;
+            while (pos < text.size()) {
+                size_t next = pos + find(text.substr(pos), mode);
+                out.append(text.data() + pos, next - pos);
+                if (next == text.size()) break;
+                unsigned char c = static_cast<unsigned char>(text[next]);
+                switch (c) {
+                    case '\n': out.append("\\n"); break;
+                    case '\r': out.append("\\r"); break;
+                    case '\t': out.append("\\t"); break;
+                    case '"': out.append("\\\""); break;
+                    case '\\': out.append("\\\\"); break;
+                    default:
+                        out.append(mode == Mode::JSON ? "\\u00" : "\\x");
+                        out.push_back(hex[c >> 4]);
+                        out.push_back(hex[c & 0xF]);
+                        break;
+                }
+                pos = next + 1;
+            }
+        }
+    }// namespace escape
+
+    // ÿյķգRCU 񣩣һ acquire ȡǰգд߸ơ޸ĺԭ滻ָ룬
+    // ɿհԪӳٻգпܻڶȡ߳뿪ͷš
+    // ÿ߳ռһλʱǼǵǰԪǶ׽ֻ߳ڵļ
+    class ConfigStore {
+        static constexpr uint64_t kIdle = UINT64_MAX;
+
+        struct Slot {
+            std::atomic<uint64_t> epoch{kIdle};
+            std::atomic<bool> owned{true};
+            uint32_t depth = 0;// ̷ֻ߳
+            Slot *next = nullptr;
+        };
+
+    public:
+        class Reader {
+        public:
+            explicit Reader(const ConfigStore &store) : slot(store.localSlot()) {
+                if (slot.depth++ == 0) {
+                    slot.epoch.store(store.epoch.load(std::memory_order_seq_cst), std::memory_order_relaxed);
+                    std::atomic_thread_fence(std::memory_order_seq_cst);// Ǽڶȡָ룬д߻ǰɨ
+                }
+                config = store.load();
+            }
+            ~Reader() {
+                if (--slot.depth == 0) slot.epoch.store(kIdle, std::memory_order_release);
+            }
+            Reader(const Reader &) = delete;
+            Reader &operator=(const Reader &) = delete;
+
+            const LogConfig *operator->() const { return config; }
+            const LogConfig &operator*() const { return *config; }
+
+        private:
+            Slot &slot;
+            const LogConfig *config;
+        };
+
+        ConfigStore() = default;
+        ~ConfigStore() {
+            delete current.load(std::memory_order_relaxed);
+            for (Retired &retired: retiredList) delete retired.config;
+            for (Slot *slot = slots.load(std::memory_order_relaxed); slot;) delete std::exchange(slot, slot->next);
+        }
+
+        Reader read() const { return Reader(*this); }
+
+        // Ƶǰգ mutate ޸ĺ󷢲¿յĸ÷Ƚ
+        template<typename Mutate>
+        LogConfig update(Mutate &&mutate) {
+            std::lock_guard<std::mutex> lock(writerMutex);
+            const LogConfig *old = load();
+            auto *next = new LogConfig(*old);
+            mutate(*next);
+            LogConfig copy = *next;
+            current.store(next, std::memory_order_seq_cst);
+            retiredList.push_back({old, epoch.fetch_add(1, std::memory_order_seq_cst)});
+            reclaimLocked();
+            return copy;
+        }
+
+        // ͷѾûжߵľɿգɺ̶̨߳ڵãдæʱֱӷ
+        void reclaim() {
+            std::unique_lock<std::mutex> lock(writerMutex, std::try_to_lock);
+            if (lock.owns_lock() && !retiredList.empty()) reclaimLocked();
+        }
+
+        size_t retiredCount() const {
+            std::lock_guard<std::mutex> lock(writerMutex);
+            return retiredList.size();
+        }
+
+    private:
+        struct Retired {
+            const LogConfig *config;
+            uint64_t epoch;// 滻ʱļԪԪĶ߿ܻʹ
+        };
+
+        // ߳˳ʱλ߳ȸ
+        struct SlotOwner {
+            Slot *slot = nullptr;
+            ~SlotOwner() {
+                if (slot) slot->owned.store(false, std::memory_order_release);
+            }
+        };
+
+        // һζȡʱŴĬã̬ʼ׶ε־Ҳܶ
+        const LogConfig *load() const {
+            const LogConfig *config = current.load(std::memory_order_acquire);
+            if (config) return config;
+            auto *fresh = new LogConfig;
+            if (current.compare_exchange_strong(config, fresh, std::memory_order_acq_rel)) return fresh;
+            delete fresh;
+            return config;
+        }
+
+        Slot &localSlot() const {
+            static thread_local SlotOwner owner;
+            if (owner.slot) return *owner.slot;
+            for (Slot *slot = slots.load(std::memory_order_acquire); slot; slot = slot->next) {
+                bool expected = false;
+                if (slot->owned.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+                    owner.slot = slot;
+                    return *slot;
+                }
+            }
+            auto *slot = new Slot;
+            slot->next = slots.load(std::memory_order_relaxed);
+            while (!slots.compare_exchange_weak(slot->next, slot, std::memory_order_release, std::memory_order_relaxed)) {}
+            owner.slot = slot;
+            return *slot;
+        }
+
+        void reclaimLocked() {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            uint64_t oldest = kIdle;
+            for (Slot *slot = slots.load(std::memory_order_acquire); slot; slot = slot->next) {
+                oldest = std::min(oldest, slot->epoch.load(std::memory_order_seq_cst));
+            }
+            std::erase_if(retiredList, [oldest](const Retired &retired) {
+                if (retired.epoch >= oldest) return false;
+                delete retired.config;
+                return true;
+            });
+        }
+
+        mutable std::atomic<const LogConfig *> current{nullptr};
+        std::atomic<uint64_t> epoch{1};
+        mutable std::atomic<Slot *> slots{nullptr};
+        mutable std::mutex writerMutex;
+        std::vector<Retired> retiredList;
+    };
+
+    // ־õ㣺PEBBLELOG Ⱥÿλ÷һ̬ CallSiteһִʱǼǵעš
+    // ¼ֻЯָָ룬ļкźͺʱȡáеرĳõ
+    struct CallSite {
+        CallSite(const char *file, int line, const char *function, std::string_view format, LogLevel level);
+        CallSite(const CallSite &) = delete;
+        CallSite &operator=(const CallSite &) = delete;
+
+        bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+        // ȥĿ¼ļ
+        std::string_view fileName() const {
+            std::string_view path(file);
+            size_t slash = path.find_last_of("/\\");
+            return slash == std::string_view::npos ? path : path.substr(slash + 1);
+        }
+
+        const char *file;
+        int line;
+        const char *function;
+        std::string_view format;// Ĳֱַ
+        LogLevel level;
+        uint32_t id = 0;              // Ǽ˳򣬴 1 ʼ
+        std::atomic<bool> enabled{true};
+        std::atomic<uint64_t> hits{0};// ͨˡʵʲļ¼
+    };
+
+    // õĿգѯӿڷ
+    struct CallSiteInfo {
+        uint32_t id;
+        std::string file;
+        int line;
+        std::string function;
+        std::string format;
+        LogLevel level;
+        bool enabled;
+        uint64_t hits;
+    };
+
+    // еǼǹĵõ㡣ǼֻÿõһִʱѯͿ߼·
+    // ¼־ʱֻȡõԼԭӱλõĿػᱣ֮ŵǼǵĵõͬ
+    class CallSiteRegistry {
+    public:
+        void add(CallSite &site) {
+            std::lock_guard<std::mutex> lock(mutex);
+            sites.push_back(&site);
+            site.id = static_cast<uint32_t>(sites.size());
+            for (const Rule &rule: rules) {
+                if (matches(site, rule.location)) site.enabled.store(rule.enabled, std::memory_order_relaxed);
+            }
+        }
+
+        std::vector<CallSiteInfo> snapshot() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::vector<CallSiteInfo> result;
+            result.reserve(sites.size());
+            for (const CallSite *site: sites) {
+                result.push_back({site->id, site->file, site->line, site->function, std::string(site->format), site->level,
+                                  site->isEnabled(), site->hits.load(std::memory_order_relaxed)});
+            }
+            return result;
+        }
+
+        bool setEnabled(uint32_t id, bool enabled) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (id == 0 || id > sites.size()) return false;
+            sites[id - 1]->enabled.store(enabled, std::memory_order_relaxed);
+            return true;
+        }
+
+        // location Ϊ "ļ"  "ļ:к"ļ·ĩβֱȽϡѵǼǵĵõƥ
+        size_t setEnabled(std::string_view location, bool enabled) {
+            std::lock_guard<std::mutex> lock(mutex);
+            // ͬһλõøǾɵģ
+            std::erase_if(rules, [location](const Rule &rule) { return rule.location == location; });
+            rules.push_back({std::string(location), enabled});
+            size_t matched = 0;
+            for (CallSite *site: sites) {
+                if (!matches(*site, location)) continue;
+                site->enabled.store(enabled, std::memory_order_relaxed);
+                ++matched;
+            }
+            return matched;
+        }
+
+        void resetHits() {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (CallSite *site: sites) site->hits.store(0, std::memory_order_relaxed);
+        }
+
+    private:
+        struct Rule {
+            std::string location;
+            bool enabled;
+        };
+
+        static bool matches(const CallSite &site, std::string_view location) {
+            std::string_view file = location;
+            size_t colon = location.rfind(':');
+            if (colon != std::string_view::npos && colon + 1 < location.size() &&
+                location.find_first_not_of("0123456789", colon + 1) == std::string_view::npos) {
+                file = location.substr(0, colon);
+                int line = 0;
+                std::from_chars(location.data() + colon + 1, location.data() + location.size(), line);
+                if (line != site.line) return false;
+            }
+            std::string_view path(site.file);
+            if (!path.ends_with(file)) return false;
+            return path.size() == file.size() || path[path.size() - file.size() - 1] == '/' || path[path.size() - file.size() - 1] == '\\';
+        }
+
+        mutable std::mutex mutex;
+        std::vector<CallSite *> sites;// ±Ϊż 1
+        std::vector<Rule> rules;
+    };
+
+    // ʽʽַֻڱ仯һΣһƽĲʱ䡢
+    // ߳ IDʱ䡢Ϣģִʱ˳ֱ׷ӵĿ껺壬ʱַ
+    // ÿ̳߳Լʵеʱ仺ͬһֻһ strftime
+    class PatternFormatter {
+    public:
+        struct Context {
+            LogLevel level;
+            uint64_t threadId;
+            int64_t wallNanos;
+            const CallSite *site = nullptr;// ͨ¼־ûеõ㣬ӦֶΪ
+        };
+
+        bool isCompiled(uint32_t version) const { return compiled && compiledVersion == version; }
+
+        // pattern ΪʱʹĬϲ "[ʱ] ǰ׺ [] Ϣ"ʱʽǰ׺ȡ
+        void compile(const LogConfig &config, uint32_t version) {
+            ops.clear();
+            literals.clear();
+            times.clear();
+            messageIndex = SIZE_MAX;
+            escapeMode = config.outputFormat == OutputFormat::JSON          ? escape::Mode::JSON
+                         : config.outputFormat == OutputFormat::SINGLE_LINE ? escape::Mode::SINGLE_LINE
+                                                                             : escape::Mode::NONE;
+            if (config.outputFormat == OutputFormat::JSON) {
+                addLiteral("{\"time\":\"");
+                addTime(config.timeFormat, escape::Mode::JSON);
+                addLiteral(".");
+                ops.push_back({MILLIS});
+                addLiteral("\",\"level\":\"");
+                ops.push_back({LEVEL});
+                addLiteral("\",\"thread\":");
+                ops.push_back({THREAD});
+                if (!config.prefixFormat.empty()) {
+                    std::string name;
+                    escape::append(config.prefixFormat, escape::Mode::JSON, name);
+                    addLiteral(",\"name\":\"");
+                    addLiteral(name);
+                    addLiteral("\"");
+                }
+                addLiteral(",\"message\":\"");
+                addMessage();
+                addLiteral("\"}");
+            } else if (config.pattern.empty()) {
+                addLiteral("[");
+                addTime(config.timeFormat);
+                addLiteral("] ");
+                if (!config.prefixFormat.empty()) {
+                    addLiteral(config.prefixFormat);
+                    addLiteral(" ");
+                }
+                addLiteral("[");
+                ops.push_back({LEVEL});
+                addLiteral("] ");
+                addMessage();
+            } else {
+                parse(config.pattern, config.prefixFormat);
+            }
+            if (messageIndex == SIZE_MAX) addMessage();// û %v ʱķ
+            compiled = true;
+            compiledVersion = version;
+        }
+
+        // ֮ǰĲ
+        void appendPrefix(const Context &context, std::string &out) { run(0, messageIndex, context, out); }
+        // ֮Ĳ֣ʽΪ
+        void appendSuffix(const Context &context, std::string &out) { run(messageIndex + 1, ops.size(), context, out); }
+        bool hasSuffix() const { return messageIndex + 1 < ops.size(); }
+        // ϢҪת巽ʽ
+        escape::Mode escaping() const { return escapeMode; }
+
+    private:
+        enum Kind : uint8_t {
+            LITERAL,   //  literals еһ
+            TIME,      //  times[index] ĸʽʱ
+            MILLIS,    // %e
+            MICROS,    // %f
+            NANOS,     // %F
+            LEVEL,     // %l
+            LEVEL_SHORT,// %L
+            THREAD,    // %t
+            SOURCE_FILE,// %sĿ¼
+            SOURCE_LINE,// %#
+            FUNCTION,  // %!
+            LOCATION,  // %@ļ:к
+            MESSAGE    // %v
+        };
+
+        struct Op {
+            Kind kind;
+            uint32_t offset = 0;// LITERAL  literals еλãTIME Ϊ times ±
+            uint32_t length = 0;
+        };
+
+        struct TimeSlot {
+            std::string format;
+            std::time_t second = -1;
+            size_t length = 0;
+            char text[64]{};
+            escape::Mode escaping = escape::Mode::NONE;// JSON еʱ䰴ַת壬 escaped
+            std::string escaped;
+        };
+
+        static constexpr std::string_view levelNames[] = {"DEBUG", "INFO", "WARN", "ERROR", "FATAL", "TRACE"};
+        static constexpr std::string_view levelShortNames[] = {"D", "I", "W", "E", "F", "T"};
+
+        // strftime ת%e/%f/%F/%l/%L/%t/%n/%v Լõ %s/%#/%!/%@ ɸʽԼ
+        static bool isTimeConversion(char c) { return std::string_view("YmdHMSyCbBhaAjIpzZTDRcxXuwUVGgr").find(c) != std::string_view::npos; }
+
+        void addLiteral(std::string_view text) {
+            if (text.empty()) return;
+            if (!ops.empty() && ops.back().kind == LITERAL && ops.back().offset + ops.back().length == literals.size()) {
+                ops.back().length += static_cast<uint32_t>(text.size());// ǰһڣϲΪһθ
+            } else {
+                ops.push_back({LITERAL, static_cast<uint32_t>(literals.size()), static_cast<uint32_t>(text.size())});
+            }
+            literals.append(text);
+        }
+
+        void addTime(std::string format, escape::Mode escaping = escape::Mode::NONE) {
+            ops.push_back({TIME, static_cast<uint32_t>(times.size())});
+            TimeSlot &slot = times.emplace_back();
+            slot.format = std::move(format);
+            slot.escaping = escaping;
+        }
+
+        void addMessage() {
+            messageIndex = ops.size();
+            ops.push_back({MESSAGE});
+        }
+
+        // ڵʱתͬмϲһ strftime "%Y-%m-%d %H:%M:%S"
+        void parse(std::string_view pattern, std::string_view name) {
+            std::string literal;
+            std::string timeRun;
+            auto closeTime = [&] {
+                if (!timeRun.empty()) addTime(std::exchange(timeRun, {}));
+            };
+            auto flushLiteral = [&] {
+                closeTime();
+                addLiteral(literal);
+                literal.clear();
+            };
+            for (size_t i = 0; i < pattern.size(); ++i) {
+                char c = pattern[i];
+                if (c != '%' || i + 1 == pattern.size()) {
+                    literal.push_back(c);
+                    continue;
+                }
+                char spec = pattern[++i];
+                if (isTimeConversion(spec)) {
+                    if (timeRun.empty()) {
+                        addLiteral(literal);
+                    } else {
+                        for (char l: literal) {
+                            timeRun.push_back(l);
+                            if (l == '%') timeRun.push_back('%');
+                        }
+                    }
+                    literal.clear();
+                    timeRun.push_back('%');
+                    timeRun.push_back(spec);
+                    continue;
+                }
+                switch (spec) {
+                    case '%': literal.push_back('%'); break;
+                    case 'n': literal.append(name); break;
+                    case 'e': flushLiteral(); ops.push_back({MILLIS}); break;
+                    case 'f': flushLiteral(); ops.push_back({MICROS}); break;
+                    case 'F': flushLiteral(); ops.push_back({NANOS}); break;
+                    case 'l': flushLiteral(); ops.push_back({LEVEL}); break;
+                    case 'L': flushLiteral(); ops.push_back({LEVEL_SHORT}); break;
+                    case 't': flushLiteral(); ops.push_back({THREAD}); break;
+                    case 's': flushLiteral(); ops.push_back({SOURCE_FILE}); break;
+                    case '#': flushLiteral(); ops.push_back({SOURCE_LINE}); break;
+                    case '!': flushLiteral(); ops.push_back({FUNCTION}); break;
+                    case '@': flushLiteral(); ops.push_back({LOCATION}); break;
+                    case 'v':
+                        flushLiteral();
+                        if (messageIndex == SIZE_MAX) addMessage();// ֻȡһ %v
+                        break;
+                    default:
+                        literal.push_back('%');// δ֪תԭ
+                        literal.push_back(spec);
+                        break;
+                }
+            }
+            flushLiteral();
+        }
+
+        static void appendDigits(std::string &out, uint64_t value, int width) {
+            char digits[20];
+            for (int i = width - 1; i >= 0; --i) {
+                digits[i] = static_cast<char>('0' + value % 10);
+                value /= 10;
+            }
+            out.append(digits, static_cast<size_t>(width));
+        }
+
+        static void appendNumber(std::string &out, uint64_t value) {
+            char digits[20];
+            auto result = std::to_chars(digits, digits + sizeof(digits), value);
+            out.append(digits, static_cast<size_t>(result.ptr - digits));
+        }
+
+        void run(size_t begin, size_t end, const Context &context, std::string &out) {
+            std::time_t second = static_cast<std::time_t>(context.wallNanos / 1000000000);
+            int64_t subsecond = context.wallNanos % 1000000000;
+            if (subsecond < 0) {
+                --second;
+                subsecond += 1000000000;
+            }
+            for (size_t i = begin; i < end; ++i) {
+                const Op &op = ops[i];
+                switch (op.kind) {
+                    case LITERAL: out.append(literals, op.offset, op.length); break;
+                    case TIME: appendTime(times[op.offset], second, out); break;
+                    case MILLIS: appendDigits(out, static_cast<uint64_t>(subsecond / 1000000), 3); break;
+                    case MICROS: appendDigits(out, static_cast<uint64_t>(subsecond / 1000), 6); break;
+                    case NANOS: appendDigits(out, static_cast<uint64_t>(subsecond), 9); break;
+                    case LEVEL: out.append(levelNames[static_cast<size_t>(context.level)]); break;
+                    case LEVEL_SHORT: out.append(levelShortNames[static_cast<size_t>(context.level)]); break;
+                    case THREAD: appendNumber(out, context.threadId); break;
+                    case SOURCE_FILE:
+                        if (context.site) out.append(context.site->fileName());
+                        break;
+                    case SOURCE_LINE:
+                        if (context.site) appendNumber(out, static_cast<uint64_t>(context.site->line));
+                        break;
+                    case FUNCTION:
+                        if (context.site) out.append(context.site->function);
+                        break;
+                    case LOCATION:
+                        if (!context.site) break;
+                        out.append(context.site->fileName()).push_back(':');
+                        appendNumber(out, static_cast<uint64_t>(context.site->line));
+                        break;
+                    case MESSAGE: break;
+                }
+            }
+        }
+
+        static void appendTime(TimeSlot &slot, std::time_t second, std::string &out) {
+            if (second != slot.second) {
+                std::tm tm;
+#ifdef _WIN32
+                localtime_s(&tm, &second);
+#else
+                localtime_r(&second, &tm);// localtime عľ̬壬߳²ȫ
+#endif
+                slot.length = std::strftime(slot.text, sizeof(slot.text), slot.format.c_str(), &tm);
+                slot.second = second;
+                if (slot.escaping != escape::Mode::NONE) {
+                    slot.escaped.clear();
+                    escape::append(std::string_view(slot.text, slot.length), slot.escaping, slot.escaped);
+                }
+            }
+            if (slot.escaping != escape::Mode::NONE) {
+                out.append(slot.escaped);
+            } else {
+                out.append(slot.text, slot.length);
+            }
+        }
+
+        std::vector<Op> ops;
+        std::string literals;
+        std::vector<TimeSlot> times;
+        size_t messageIndex = SIZE_MAX;
+        escape::Mode escapeMode = escape::Mode::NONE;
+        bool compiled = false;
+        uint32_t compiledVersion = 0;
+    };
+
+    // ļļд滻ûصLinux ʹ inotify Ŀ¼༭ͨʽ棩
+    // ƽ̨޸ʱ
+    class ConfigFileWatcher;
+    class SharedRing;
+    class SharedRingCollector;
+    class SocketSink;
+    class DirectFileWriter;
+
+    // ˳ʱľ̬fork ӽ̼̳˸еȴ߳ļһֱȴ
+    template<typename T>
+    union Immortal {
+        constexpr Immortal() : value() {}
+        ~Immortal() {}
+        T value;
+    };
+
+    class PebbleLog {
+        friend class MiddlewareChain;// м˽гԱ
+        friend struct CallSite;     // һִʱǼǵ callSites
+    public:
+        // ־¼
+        template<typename... Args>
+        static void info(const std::string_view formatStr, Args &&...args) {
+            vlog(LogLevel::INFO, formatStr, std::make_format_args(args...));
+        }
+        template<typename... Args>
+        static void debug(const std::string_view formatStr, Args &&...args) {
+            vlog(LogLevel::DEBUG, formatStr, std::make_format_args(args...));
+        }
+        template<typename... Args>
+        static void warn(const std::string_view formatStr, Args &&...args) {
+            vlog(LogLevel::WARN, formatStr, std::make_format_args(args...));
+        }
+        template<typename... Args>
+        static void error(const std::string_view formatStr, Args &&...args) {
+            vlog(LogLevel::ERROR, formatStr, std::make_format_args(args...));
+        }
+        template<typename... Args>
+        static void fatal(const std::string_view formatStr, Args &&...args) {
+            vlog(LogLevel::FATAL, formatStr, std::make_format_args(args...));
+        }
+        template<typename... Args>
+        static void trace(const std::string_view formatStr, Args &&...args) {
+            vlog(LogLevel::TRACE, formatStr, std::make_format_args(args...));
+        }
+
+        // õڣ PEBBLELOGرյĵõֱӷأʽ
+        template<typename... Args>
+        static void logAt(CallSite &site, Args &&...args) {
+            if (!site.isEnabled()) return;
+            vlogAt(site, std::make_format_args(args...));
+        }
+        static void vlogAt(CallSite &site, std::format_args args);
+
+        // õע鿴õļ¼Żλã"ļ"  "ļ:к"صõ㡣
+        // λõö֮ŵһִеĵõͬЧ
+        static std::vector<CallSiteInfo> getCallSites();
+        static bool setCallSiteEnabled(uint32_t id, bool enabled);
+        static size_t setCallSiteEnabled(std::string_view location, bool enabled);
+        static void resetCallSiteHits();
+
+        // ־
+        static void log(LogLevel level, std::string_view message);
+        // δʽڣڵǰʱʽڿʱд뻷λ
+        static void vlog(LogLevel level, std::string_view formatStr, std::format_args args);
+
+        // ݻ壺ÿ̱߳ count ڵǰ־߳ ERROR/FATAL ʱ
+        // dumpBacktrace յ̵߳Ļ
+        static void enableBacktrace(size_t count);
+        static void disableBacktrace();
+        static void dumpBacktrace();
+
+        //  SIGSEGV/SIGABRT/SIGBUS/SIGFPEδдļ¼ͬд׳źţ
+        //  FATAL ־Ҳ̡ͬcapacity Ϊ׷صδд¼
+        static void installCrashHandler(size_t capacity = PendingRecordRing::kDefaultSlotCount);
+        static void uninstallCrashHandler();
+
+        // ֱǰӵм¼д̨/ļ
+        static void flush();
+
+        // дһҪ־ûȷϵļ¼صȷڼ¼ fdatasync ֮
+        // ͬһεĲϲΪһͬ÷PebbleLog::durable(...).wait()  co_await PebbleLog::durable(...)
+        template<typename... Args>
+        static DurableAck durable(LogLevel level, std::string_view formatStr, Args &&...args) {
+            return vlogDurable(level, formatStr, std::make_format_args(args...));
+        }
+        static DurableAck vlogDurable(LogLevel level, std::string_view formatStr, std::format_args args);
+
+        // ڴ滷̨/ļУ LogType::NONE Ϊ I/O ʹá
+        // һεʱ capacity ֮󷵻ͬһʵ
+        static MemorySink &enableMemorySink(size_t capacity = 1024);
+        static void disableMemorySink();
+        static MemorySink *getMemorySink();
+
+        // ׽ POSIX̨/ļУ緢͸ syslog 򱾻ռ
+        // ɶ߳ͲԶٴεû滻֮ǰ
+        static bool enableSocketSink(const SocketSinkOptions &options = {});
+        static void disableSocketSink();
+        static SocketSinkStats getSocketSinkStats();
+
+        // ÷
+        static void setLogLevel(LogLevel level);
+        static void setLogType(LogType type);
+        static void setMaxFileSize(size_t size);
+        static void setMaxFileCount(size_t count);
+        static void setLogPath(const std::string &path);
+        static void setLogName(const std::string &name);
+        static void setTimeFormat(const std::string &format);
+        static void setConsolePrefixFormat(const std::string &prefix);
+        static void setFilePrefixFormat(const std::string &format);
+        // ʽ "%Y-%m-%d %H:%M:%S.%e [%l] [%t] %n: %v"ΪʱָĬϲ
+        static void setPattern(const std::string &pattern);
+        // ıı JSONֻתϢеĻкͿַֹα־
+        static void setOutputFormat(OutputFormat format);
+        static void setFlushPolicy(const FlushPolicy &policy);
+        // Ӧ̨ʱʱͼ¼ÿν̽ʱ WARN һ
+        static void setLoadShedding(const LoadSheddingPolicy &policy);
+        // ļϡһдļļ¼ʱЧ
+        static void setFileIndex(const FileIndexPolicy &policy);
+        // ļʽѹд "<־ļ>.pbz"ѹļдϡ
+        static void setFileCompression(const FileCompressionPolicy &policy);
+        // ļֱдռԤ´־ļЧ
+        static void setFileIo(const FileIoPolicy &policy);
+        // ̨ stdout  stderrǷɫĿǷΪն˾
+        static void setConsoleTarget(ConsoleTarget target);
+        // ʱԴTSC ģʽֻȡɺ̨㲢У׼
+        static void setTimestampSource(TimestampSource source);
+        // ̵̨߳ĵȴԣ߲ٻѺ̨̡߳sleepInterval ֻ SLEEP
+        static void setWaitStrategy(WaitStrategy strategy, std::chrono::microseconds sleepInterval = std::chrono::microseconds(100));
+        // ̵̨̳߳߳߳ CPU 󶨡߳ȼ߳´λʱЧ
+        static void setBackendThreadPlacement(const ThreadPlacement &placement);
+        static void setPoolThreadPlacement(const ThreadPlacement &placement);
+        // лдʽл SYNC ʱֹ̨̣ͣ߳ɵ߳дʣļ¼
+        static void setBackendMode(BackendMode mode);
+        static BackendMode getBackendMode();
+        // ̳߳ص߳ĬΪ 4 0 ʾ̨ļٲд̳߳صһʹú޸ģ false
+        static bool setThreadPoolSize(size_t threads);
+        // ÿ interval  INFO һָܣ0 ʾر
+        static void setMetricsLogInterval(std::chrono::milliseconds interval);
+
+        // ȡ־ߵļӳٷֲ
+        static LogMetrics getMetrics();
+
+        static std::string getLogName();
+        static std::string getConsolePrefixFormat();
+
+        // ȡǰãһ滻ȫãдڼ¼־߳
+        static LogConfig getConfig();
+        static void setConfig(const LogConfig &config);
+        //  " = ֵ" ʽļãκһʧʱԭò false
+        static bool loadConfigFile(const std::string &path);
+        // ļ֮ļÿα涼Զ¼أٴεû滻֮ǰļ
+        static bool watchConfigFile(const std::string &path);
+        static void unwatchConfigFile();
+
+        // ־ POSIXռ̴߽Ϊ name Ĺڴ滷 "/app-log"ɱ̵ĺ̨߳
+        // ͳһת߽̣ fork Ḷ́Ӻ󣬼¼ֱд빲ʹñ̵ĶС
+        // slotCount Ϊ 256 ֽڲλʱߵȴдһ˳Ľµļ¼ռΪһ
+        static bool startSharedRingCollector(const std::string &name, size_t slotCount = 16384);
+        static void stopSharedRingCollector();
+        static bool attachSharedRing(const std::string &name);
+        static void detachSharedRing();
+
+        // ڼ¼ĳκڲ
+        template<typename Func, typename... Args>
+        static void traceFunction(const char *file, int line, const char *function, Func &&func, Args &&...args) {
+            std::ostringstream oss;
+            oss << "File: " << file << ", Line: " << line << ", Function: " << function << " | ";
+            oss << "Args: ";
+            ((oss << args << " (" << typeid(args).name() << "), "), ...);
+            std::string logMessage = oss.str();
+            if (!logMessage.empty() && logMessage.back() == ' ') {
+                logMessage.pop_back();// ƳĩβĿո
+            }
+            if (!logMessage.empty() && logMessage.back() == ',') {
+                logMessage.pop_back();// ƳĩβĶ
+            }
+            log(LogLevel::TRACE, logMessage);
+
+            // ִк¼ֵ
+            auto result = func(std::forward<Args>(args)...);
+            oss.str("");
+            oss << "Return: " << result << " (" << typeid(result).name() << ")";
+            log(LogLevel::TRACE, oss.str());
+        }
+
+        // мĴ
+        class MiddlewareProxy {
+        public:
+            // ֱӽмʵ֧ʱ
+            template<typename MiddlewareType>
+            MiddlewareProxy &operator|(MiddlewareType &&middleware) {
+                using DecayedType = std::decay_t<MiddlewareType>;
+                getInstance().middlewareChain.addMiddleware<DecayedType>(std::forward<MiddlewareType>(middleware));
+                return *this;
+            }
+        };
+
+        class LogStream {
+        public:
+            // 
+            template<typename T>
+            LogStream &operator<<(const T &message) {
+                if (!stream_) {
+                    stream_ = std::make_unique<std::ostringstream>();
+                }
+                (*stream_) << message;// Ϣд뻺
+                return *this;
+            }
+
+            // д־¼
+            ~LogStream() {
+                if (stream_ && stream_->tellp() > 0) {                // 
+                    PebbleLog::log(configStore.read()->level, stream_->str());// ú־
+                }
+            }
+
+        private:
+            std::unique_ptr<std::ostringstream> stream_;// ƴϢ
+        };
+        //̬ LogStream 
+        static LogStream log() {
+            return LogStream();
+        }
+
+        // ̬ȡ
+        static MiddlewareProxy middleware() { return {}; }
+
+        // мط
+        template<typename MiddlewareType, typename... Args>
+        static void addMiddleware(Args &&...args) {
+            getInstance().middlewareChain.addMiddleware<MiddlewareType>(
+                    std::forward<Args>(args)...);
+        }
+
+        template<typename MiddlewareType, typename... Args>
+        PebbleLog &operator|(Args &&...args) {
+            addMiddleware<MiddlewareType>(std::forward<Args>(args)...);
+            return *this;
+        }
+
+        static void applyMiddlewares() {
+            getInstance().middlewareChain.process();
+        }
+
+        // ȡ
+        static std::mutex &getMutex() { return logMutex; }
+
+    private:
+        // ʵڶϣ Owner ڽ˳ʱfork ӽм̡̳̳߳߳غûжӦ̣߳
+        // ʵŲ
+        struct Owner {
+            PebbleLog *instance = new PebbleLog;
+            ~Owner();
+        };
+
+        static PebbleLog &getInstance() {
+            static Owner owner;
+            return *owner.instance;
+        }
+
+        PebbleLog();
+        ~PebbleLog();
+
+        // еһ¼жĶṹȵϢֱӿ
+        // Ĳŷŵ overflowȡԻأ̨дʱ׷ָ롣ʱǰ׺ɺ̨ʽ
+        struct alignas(64) LogRecord {
+            static constexpr size_t kRecordSize = 320;// 5 
+
+            LogLevel level = LogLevel::INFO;
+            uint32_t length = 0;   // Ϊ 0 ʾûҪд
+            uint64_t timestamp = 0;// ԭʼʱɺ̨ clockKind 㣻ʽ֮Ϊǽʱ
+            uint64_t threadId = 0;
+            uint64_t crashTicket = 0;// еƱݣ0 ʾδǼ
+            std::promise<void> *flushRequest = nullptr;// ǿʱΪ flush() 
+            DurableAck::State *durableRequest = nullptr;// ǿʱдҪͬȷ
+            const CallSite *site = nullptr;            // ͨ¼ʱĵõ
+            std::string overflow;                      // Ϣ
+            uint32_t prefixOffset = 0;                 // ̨ʽǰ׺ prefixArena еλ
+            uint16_t prefixLength = 0;                 //  kMaxAffixLength ǰ׺ͺ׺ڸʽʱض
+            uint16_t suffixLength = 0;                 // ʽ֮Ĳ֣ǰ׺
+            TimestampClock::Kind clockKind = TimestampClock::REALTIME;
+            char payload[kRecordSize - 98];
+
+            static constexpr size_t kInlineSize = sizeof(payload);
+            static constexpr size_t kMaxAffixLength = UINT16_MAX;
+
+            // Ϣģŵʱʹõ÷׼õ spill
+            void assign(std::string_view message, std::string &&spill) {
+                length = static_cast<uint32_t>(message.size());
+                if (spill.empty()) {
+                    std::memcpy(payload, message.data(), message.size());
+                } else {
+                    overflow = std::move(spill);
+                }
+            }
+
+            TimestampClock::Stamp stamp() const { return {timestamp, clockKind}; }
+            std::string_view text() const { return {overflow.empty() ? payload : overflow.data(), length}; }
+            std::string_view prefix(const std::string &arena) const { return {arena.data() + prefixOffset, prefixLength}; }
+            std::string_view suffix(const std::string &arena) const { return {arena.data() + prefixOffset + prefixLength, suffixLength}; }
+        };
+        static_assert(sizeof(LogRecord) == LogRecord::kRecordSize, "LogRecord ֶʱҪӦС payload");
+
+        // ǰ򿪵־ļֻɺ̷̨߳
+        struct LogFile {
+            int fd = -1;
+            size_t size = 0;     // дļֽжת
+            uint64_t version = 0;//  pathVersion һʱ´
+            std::string path;
+            std::string buffer;  // δд
+            size_t records = 0;  // buffer еļ¼дʧʱ붪
+            int indexFd = -1;    // ϡһεǼʱ
+            std::string indexBuffer;// ѽδдĿڶӦ־֮д
+            fileindex::Entry block{};// ۻһ
+            bool blockOpen = false;
+            std::unique_ptr<DirectFileWriter> direct;           // ֱдʱ fd ϵ write
+            bool preallocated = false;                          // رʱҪͷδԤռ
+            FileCompression compression = FileCompression::NONE;// ʱѹʽbuffer ǵǰ֡δѹ
+            framefile::Header frame{};                          // ǰ֡ļ¼ʱ
+            std::string frameBuffer;                            // ѹ֡ˢº󱣴дδ֡
+            size_t tailRaw = 0;                                 // buffer δ֡дֽ
+            size_t tailLength = 0;                              // ļ size ֮δ֡ĳ
+
+            // δдļֽѹʱδ֡дĲֲ
+            size_t unflushed() const { return buffer.size() - tailRaw; }
+        };
+
+        static constexpr size_t kSinkBufferSize = 64 * 1024;// 峬ôСʱֱд
+
+        // ʽ׷ӵ formattedMessage ĩβʱַ
+        static void formatLogMessage(const PatternFormatter::Context &context, std::string_view message, std::string &formattedMessage,
+                                     PatternFormatter &formatter);
+        // ʽ仯±뵱ǰ̵߳ĸʽ
+        static PatternFormatter &prepareFormatter(PatternFormatter &formatter);
+        static void enqueue(LogLevel level, TimestampClock::Stamp stamp, std::string_view message,
+                            DurableAck::State *durable = nullptr, const CallSite *site = nullptr);
+        static std::string spillFor(std::string_view message);
+        static uint64_t trackForCrash(LogLevel level, int64_t wallNanos, std::string_view message);
+        static std::string &scratchBuffer();
+        static bool shedding(LogLevel level);
+        static uint64_t currentThreadId();
+        static size_t countRecords(const std::vector<LogRecord> &batch);
+        void formatPrefixes(std::vector<LogRecord> &batch);
+        static void escapeMessage(LogRecord &record, escape::Mode mode);
+        void pollForRecords(std::chrono::steady_clock::time_point deadline, uint64_t appliedPlacement);
+        static void wakeBackendLocked();
+        void startBackendLocked();
+        static void submit(std::vector<LogRecord> &records);
+        static bool writeInline(std::vector<LogRecord> &records);
+        void writeInlineLocked(std::vector<LogRecord> &records);
+        static void cpuRelax();
+        static void writeLogToFile(const LogRecord &record, std::string_view prefix, std::string_view message, std::string_view suffix);
+        static void indexRecord(const LogRecord &record, size_t length, const FileIndexPolicy &policy);
+        static void closeIndexBlock();
+        static void writeLogToConsole(LogLevel level, std::string_view prefix, std::string_view message, std::string_view suffix);
+        static void flushConsole();
+        static void retainConsole();
+        static std::string logFilePath(const LogConfig &config);
+        static void openLogFile();
+        static void rotateLogFile();
+        static void closeLogFile();
+        static void writeFileBuffer();
+        static bool writeFileData(std::string_view data);
+        static void flushFile();
+        void flushSinks();
+        void commitDurable();
+        static bool shouldFlush(const FlushPolicy &policy, LogLevel level, size_t pendingBytes);
+        void writeBatch(std::vector<LogRecord> &batch, const FlushPolicy &policy);
+        void writeSegment(std::vector<LogRecord> &batch, size_t begin, size_t end, const FlushPolicy &policy);
+        static void drainPendingRecords(bool includeInFlight);
+        static void crashSignalHandler(int sig);
+        static void updateCrashLogPath();
+        template<typename Mutate>
+        static void updateConfig(Mutate &&mutate);
+        static void collectSharedRing(SharedRing &ring, const std::atomic<bool> &stopping);
+
+        static constexpr size_t kCollectBatch = 256;                          // ռÿμתе¼
+        static constexpr int kCollectSpins = 64;                              // ΪʱĴ֮ߵȴ
+        static constexpr auto kCollectWait = std::chrono::milliseconds(50);// ߵʱ䣬ʱ鱻Ĳλ
+
+        static ConfigStore configStore;
+        static std::atomic<LogLevel> levelFilter;//  level ľڷʱͬ£ֻһζȡ
+        static std::unique_ptr<ConfigFileWatcher> configWatcher;//  logMutex 
+        static std::atomic<LogType> crashLogType;               // ·ʹõͣ crashLogPath һ
+        static std::mutex logMutex;
+        static BacktraceRing backtrace;
+        static PendingRecordRing pendingRecords;
+        static CallSiteRegistry callSites;
+        static char crashLogPath[4096];// ·ʹõļԤдźŴзڴ
+        MiddlewareChain middlewareChain;// Ƕм
+
+        // 첽־
+        static std::vector<LogRecord> logQueue;// ̨νߵᱣ
+        static Immortal<std::mutex> queueMutexStorage;
+        static Immortal<std::condition_variable> queueCondStorage;
+        static std::mutex &queueMutex;
+        static std::condition_variable &queueCond;
+        static bool backendParked;                   // ̨߳ϵȴ queueMutex 
+        static std::atomic<bool> hasQueuedRecords;   // ȴѯ
+        static std::atomic<WaitStrategy> waitStrategy;
+        static std::atomic<int64_t> sleepIntervalUs;
+        static constexpr uint32_t kSpinCount = 4096;// SPIN_YIELD ʼó CPU ǰ
+        static std::mutex placementMutex;
+        static ThreadPlacement backendPlacement;
+        static std::atomic<uint64_t> backendPlacementVersion;
+        static FlushPolicy flushPolicy;// ͬʱ queueMutex  writerMutex ޸ģ̨߳ÿһݣͬд߳ writerMutex ȡ
+        static LoadSheddingPolicy loadSheddingPolicy;//  queueMutex 
+        static LoadShedder loadShedder;
+        // ͬģʽµǰ̴߳дļ¼дֲļ¼תʧܵĴ󣩷 nestedдд
+        struct InlineWriter {
+            std::vector<LogRecord> batch;
+            std::vector<LogRecord> nested;
+            bool writing = false;
+        };
+        static InlineWriter &inlineWriter();
+        // ͬģʽûк̨̣߳ʱд飬 writerMutex 
+        struct InlineSchedule {
+            std::chrono::steady_clock::time_point nextFlush;
+            std::chrono::steady_clock::time_point nextMetricsLog;
+            std::chrono::steady_clock::time_point nextCalibration;
+        };
+        static std::atomic<BackendMode> backendMode;// ͬʱ queueMutex  writerMutex ʱ޸ģ֮һȷ
+        static std::mutex writerMutex;              // ͬģʽ¸߳дĻ
+        static std::mutex modeMutex;                // л setBackendMode
+        static InlineSchedule inlineSchedule;
+        static std::chrono::milliseconds metricsLogInterval;//  flushPolicy ͬ
+        static MetricsCollector metrics;
+        static RecordBufferPool recordPool;
+        static TimestampClock clock;
+        static std::atomic<uint32_t> formatVersion;// ʽʱʽǰ׺仯ʱ̵߳ĸʽ֮±
+        static std::unique_ptr<MemorySink> memorySinkOwner;
+        static std::atomic<MemorySink *> memorySink;// Ϊձʾδ
+        static std::unique_ptr<SocketSink> socketSinkOwner;//  logMutex 
+        static std::atomic<SocketSink *> socketSink;       // Ϊձʾδ
+        static std::vector<std::unique_ptr<SharedRing>> sharedRings;// ӹĹӳ䱣˳ logMutex 
+        static std::atomic<SharedRing *> sharedRing;                // ߵǰдĹΪձʾʹñ̵Ķ
+        static std::unique_ptr<SharedRingCollector> ringCollector;  //  logMutex 
+        static std::atomic<uint64_t> pathVersion;
+#ifndef _WIN32
+        static std::vector<iovec> consoleIov;// дķֶΣָеϢ;̬ɫ
+        static std::string consoleCarry;     // αδдݣΪʱ consoleIov ĵһֶ
+#endif
+        static size_t consoleBytes;
+        static std::atomic<int> consoleFd;
+        static std::atomic<bool> consoleColors;// Ŀնʱɫ
+        static LogFile logFile;
+        static std::atomic<DirectFileWriter *> crashDirect;// ǰֱдļʱȽص׷
+        static std::vector<DurableAck::State *> durableRequests;// ǰεȴֻͬɺ̷̨߳
+        static bool durableSyncFailed;                          // ǰ;رյļͬʧ
+        std::vector<uint64_t> unflushedTickets;// д뻺嵫δˢµıƱ
+        std::string prefixArena;               // ǰм¼ǰ׺ֻɺ̷̨߳
+        PatternFormatter formatter;            // ̵̨߳ĸʽ
+        std::atomic<bool> stopFlag;
+        bool detachBackend = false;//  queueMutex  stopFlag һą̃߳д굱ǰμ˳ſն
+        std::thread logThread;
+        bool backendStarted = false;//  queueMutex 
+        ThreadPool threadPool;
+        ContinuationThread continuations;
+        int64_t creatorPid = 0;// ʵḶ̌˳ʱݴʶ fork ӽ
+        // ֻ̳߳д̨ͻָȴ־ûȷϵЭ̣Ҫ
+        static constexpr size_t kDefaultPoolSize = 4;
+
+        void processLogs();
+    };
+
+}// namespace utils::Log
+
+#define PEBBLETRACE(func, ...) \
+    PebbleLog::traceFunction(__FILE__, __LINE__, __func__, func, ##__VA_ARGS__);
+
+// õ־꣺ÿλõһִʱǼǵע֮еزͳƲļ¼
+// fmt ַ
+// õֱøʽַ"" fmt ÷ std::string ڱʱ
+#define PEBBLELOG(level, fmt, ...)                                                                    \
+    do {                                                                                              \
+        static ::utils::Log::CallSite pebbleCallSite(__FILE__, __LINE__, __func__, "" fmt, level);   \
+        ::utils::Log::PebbleLog::logAt(pebbleCallSite, ##__VA_ARGS__);                               \
+    } while (0)
+
+#define PEBBLEDEBUG(fmt, ...) PEBBLELOG(::utils::Log::LogLevel::DEBUG, fmt, ##__VA_ARGS__)
+#define PEBBLEINFO(fmt, ...) PEBBLELOG(::utils::Log::LogLevel::INFO, fmt, ##__VA_ARGS__)
+#define PEBBLEWARN(fmt, ...) PEBBLELOG(::utils::Log::LogLevel::WARN, fmt, ##__VA_ARGS__)
+#define PEBBLEERROR(fmt, ...) PEBBLELOG(::utils::Log::LogLevel::ERROR, fmt, ##__VA_ARGS__)
+#define PEBBLEFATAL(fmt, ...) PEBBLELOG(::utils::Log::LogLevel::FATAL, fmt, ##__VA_ARGS__)
+
+#include <chrono>
+#include <ctime>
+#include <mutex>
+#include <sstream>
+#include <type_traits>
+
+namespace utils::Log::MiddleWare {
+
+    // ʹ chrono ȡʱ䲢ʽΪַ
+    inline std::string getLocalTimeString(const std::string &format = "%Y-%m-%d %H:%M:%S") {
+        // ȡǰʱ
+        auto now = std::chrono::system_clock::now();
+        // תΪ time_t
+        std::time_t now_time_t = std::chrono::system_clock::to_time_t(now);
+        // תΪʱ
+        std::tm localTime;
+#ifdef _WIN32
+        localtime_s(&localTime, &now_time_t);// Windows ʹ localtime_s
+#else
+        localtime_r(&now_time_t, &localTime);// Linux ʹ localtime_r
+#endif
+
+        // ʽʱ
+        char timeStr[20];
+        std::strftime(timeStr, sizeof(timeStr), format.c_str(), &localTime);
+        return std::string(timeStr);
+    }
+
+    class LocalTimeStampMiddleware : public LoggerMiddleware<LocalTimeStampMiddleware> {
+    public:
+        LocalTimeStampMiddleware() : formatStr("%Y-%m-%d %H:%M:%S") {}
+
+        template<typename T>
+            requires std::is_constructible_v<std::string, T>
+        LocalTimeStampMiddleware(T &&format) : formatStr(std::forward<T>(format)) {
+            static_assert(!std::is_same_v<std::decay_t<T>, std::string> || !formatStr.empty(),
+                          "Time format string must not be empty.");
+            static_assert(std::is_constructible_v<std::string, T>,
+                          "Template parameter must be convertible to std::string.");
+        }
+
+        void process() {
+            // 浱ǰʱظ
+            auto currentTime = std::time(nullptr);
+            std::lock_guard<std::mutex> lock(PebbleLog::getMutex());
+            // ʱδʼԽ뼶ʱ߽磬ʱ
+            if (!timeStrInitialized || std::difftime(currentTime, lastUpdateTime) >= 1) {
+                timeStr = getLocalTimeString(formatStr);
+                timeStrInitialized = true;
+                lastUpdateTime = currentTime;// ʱ
+            }
+            PebbleLog::setLogName(std::move(PebbleLog::getLogName() + "[" + timeStr + "]"));
+            PebbleLog::setTimeFormat(formatStr);
+        }
+
+    private:
+        std::string formatStr;
+        std::string timeStr;
+        bool timeStrInitialized = false;// ʱǷѳʼ
+        std::time_t lastUpdateTime = 0; // ¼ϴθʱʱ
+    };
+
+    class DailyLogMiddleware : public LoggerMiddleware<DailyLogMiddleware> {
+    public:
+        DailyLogMiddleware() {}
+
+        void process() {
+            std::lock_guard<std::mutex> lock(PebbleLog::getMutex());
+            std::string dateStr = getLocalTimeString("%Y-%m-%d");
+            std::string logName = PebbleLog::getLogName();
+            size_t dotPos = logName.find_last_of('.');
+            if (dotPos != std::string::npos) {
+                // ļв
+                std::string newLogName = logName.substr(0, dotPos) + "_" + dateStr + logName.substr(dotPos);
+                PebbleLog::setLogName(newLogName);
+            } else {
+                // ûչֱļ
+                PebbleLog::setLogName(logName + "_" + dateStr);
+            }
+        }
+    };
+
+    class TraceMiddleware : public LoggerMiddleware<TraceMiddleware> {
+    public:
+        TraceMiddleware(const std::string &file, int line, const std::string &func, const std::string &args)
+            : file(file), line(line), func(func), args(args) {}
+
+        void process() {
+            std::lock_guard<std::mutex> lock(PebbleLog::getMutex());
+            std::stringstream ss;
+            ss << "[Trace] File: " << file << ", Line: " << line << ", Function: " << func << ", Args: " << args;
+            PebbleLog::info(ss.str());// ʹ־
+        }
+
+    private:
+        std::string file;
+        int line;
+        std::string func;
+        std::string args;
+    };
+
+    class ThreadIDMiddleware : public LoggerMiddleware<ThreadIDMiddleware> {
+    public:
+        ThreadIDMiddleware() {}
+
+        void process() {
+            std::lock_guard<std::mutex> lock(PebbleLog::getMutex());
+            std::stringstream ss;
+            ss << "[ThreadID:" << std::this_thread::get_id() << "] ";
+            PebbleLog::setConsolePrefixFormat(ss.str() + PebbleLog::getConsolePrefixFormat());
+        }
+    };
+
+    class CustomTagMiddleware : public LoggerMiddleware<CustomTagMiddleware> {
+    public:
+        CustomTagMiddleware(const std::string &tag) : tag(tag) {}
+
+        void process() {
+            std::lock_guard<std::mutex> lock(PebbleLog::getMutex());
+            PebbleLog::setConsolePrefixFormat("[" + tag + "] " + PebbleLog::getConsolePrefixFormat());
+        }
+
+    private:
+        std::string tag;
+    };
+}// namespace utils::Log::MiddleWare
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>//  open
+#include <filesystem>
+#include <fstream>
+#ifdef _WIN32
+#include <io.h>// for _open, _close
+#include <sys/stat.h>
+#include <windows.h>
+#undef ERROR// ȡ궨
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>// setpriority
+#include <sys/syscall.h> // SYS_gettid
+#include <unistd.h>
+#endif
+#ifndef _WIN32
+#include <sys/mman.h>// shm_open, mmap
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#endif
+#ifdef __linux__
+#include <linux/futex.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#endif
+
+namespace utils::Log {
+    namespace io {
+        // ļдװֻʹ첽źŰȫϵͳã·ҲԵ
+        inline int openForAppend(const char *path) {
+#ifdef _WIN32
+            return _open(path, _O_WRONLY | _O_APPEND | _O_CREAT, _S_IREAD | _S_IWRITE);
+#else
+            return ::open(path, O_WRONLY | O_APPEND | O_CREAT, 0644);
+#endif
+        }
+
+        // ȫдʱ true ENOSPCEIOʱдĲ޷
+        inline bool writeAll(int fd, const char *data, size_t length) {
+            while (length > 0) {
+#ifdef _WIN32
+                int written = _write(fd, data, static_cast<unsigned int>(length));
+#else
+                ssize_t written = ::write(fd, data, length);
+#endif
+                if (written <= 0) {
+                    if (written < 0 && errno == EINTR) continue;
+                    return false;
+                }
+                data += written;
+                length -= static_cast<size_t>(written);
+            }
+            return true;
+        }
+
+        // ѹḲļβδ֡λд룬׷ӷʽ
+        inline int openForWrite(const char *path) {
+#ifdef _WIN32
+            return _open(path, _O_WRONLY | _O_CREAT | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+            return ::open(path, O_WRONLY | O_CREAT, 0644);
+#endif
+        }
+
+        inline bool writeAllAt(int fd, const char *data, size_t length, uint64_t offset) {
+#ifdef _WIN32
+            if (_lseeki64(fd, static_cast<__int64>(offset), SEEK_SET) < 0) return false;
+            return writeAll(fd, data, length);
+#else
+            while (length > 0) {
+                ssize_t written = ::pwrite(fd, data, length, static_cast<off_t>(offset));
+                if (written <= 0) {
+                    if (written < 0 && errno == EINTR) continue;
+                    return false;
+                }
+                data += written;
+                length -= static_cast<size_t>(written);
+                offset += static_cast<uint64_t>(written);
+            }
+            return true;
+#endif
+        }
+
+#ifdef _WIN32
+        constexpr int stdoutFd = 1;
+        constexpr int stderrFd = 2;
+
+        inline bool isTerminal(int fd) { return _isatty(fd) != 0; }
+#else
+        constexpr int stdoutFd = STDOUT_FILENO;
+        constexpr int stderrFd = STDERR_FILENO;
+
+        inline bool isTerminal(int fd) { return isatty(fd) != 0; }
+
+        // ֶдд룬ʵдֽiov ᱻ޸
+        inline size_t writevAll(int fd, iovec *iov, size_t count) {
+            size_t total = 0;
+            while (count > 0) {
+                int chunk = static_cast<int>(std::min<size_t>(count, IOV_MAX));
+                ssize_t written = ::writev(fd, iov, chunk);
+                if (written < 0 && errno == EINTR) continue;
+                if (written <= 0) break;
+                total += static_cast<size_t>(written);
+                // дķֶΣʣಿִӶϵ
+                size_t remaining = static_cast<size_t>(written);
+                while (count > 0 && remaining >= iov->iov_len) {
+                    remaining -= iov->iov_len;
+                    ++iov;
+                    --count;
+                }
+                if (remaining > 0) {
+                    iov->iov_base = static_cast<char *>(iov->iov_base) + remaining;
+                    iov->iov_len -= remaining;
+                }
+            }
+            return total;
+        }
+#endif
+
+#ifndef _WIN32
+        // ƹҳ򿪣׷ӣֱдҪƫƺͳȶ룬ɵ÷дλãؽβһҳĲ֡
+        // ļϵͳ֧ʱ -1
+        inline int openForDirectWrite(const char *path) {
+#if defined(__linux__)
+            return ::open(path, O_RDWR | O_CREAT | O_CLOEXEC | O_DIRECT, 0644);
+#elif defined(__APPLE__)
+            int fd = ::open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+            if (fd >= 0 && ::fcntl(fd, F_NOCACHE, 1) != 0) {
+                ::close(fd);
+                return -1;
+            }
+            return fd;
+#else
+            (void) path;
+            errno = EINVAL;
+            return -1;
+#endif
+        }
+#endif
+
+        // Ԥ size ֽڵĴ̿ռ䣬ıļ
+        inline bool preallocate(int fd, size_t size) {
+#ifdef __linux__
+            return ::fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(size)) == 0;
+#else
+            (void) fd;
+            (void) size;
+            return false;
+#endif
+        }
+
+        // ضϵ sizeͬʱͷļĩβ֮ԤĿռ
+        inline void truncate(int fd, uint64_t size) {
+#ifdef _WIN32
+            _chsize_s(fd, static_cast<__int64>(size));
+#else
+            while (::ftruncate(fd, static_cast<off_t>(size)) != 0 && errno == EINTR) {}
+#endif
+        }
+
+        // ֻͬݺȷļԪ
+        inline bool syncData(int fd) {
+#ifdef _WIN32
+            return _commit(fd) == 0;
+#elif defined(__linux__)
+            return ::fdatasync(fd) == 0;
+#else
+            return ::fsync(fd) == 0;
+#endif
+        }
+
+        inline void closeFd(int fd) {
+#ifdef _WIN32
+            _close(fd);
+#else
+            ::close(fd);
+#endif
+        }
+    }// namespace io
+
+    class ConfigFileWatcher {
+    public:
+        static constexpr auto kPollInterval = std::chrono::seconds(1);// ֧ inotify ʱ޸ʱļ
+
+        ConfigFileWatcher(std::string path, std::function<void()> onChange) : path(std::move(path)), onChange(std::move(onChange)) {
+#ifdef __linux__
+            std::filesystem::path file(this->path);
+            std::string directory = file.has_parent_path() ? file.parent_path().string() : std::string(".");
+            fileName = file.filename().string();
+            inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+            wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (inotifyFd >= 0 && inotify_add_watch(inotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+                io::closeFd(inotifyFd);
+                inotifyFd = -1;
+            }
+            if (inotifyFd >= 0 && wakeFd >= 0) {
+                thread = std::thread(&ConfigFileWatcher::watchEvents, this);
+                return;
+            }
+#endif
+            thread = std::thread(&ConfigFileWatcher::pollModifiedTime, this);
+        }
+
+        ~ConfigFileWatcher() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            cond.notify_all();
+#ifdef __linux__
+            if (wakeFd >= 0) {
+                uint64_t one = 1;
+                [[maybe_unused]] ssize_t written = ::write(wakeFd, &one, sizeof(one));
+            }
+#endif
+            if (thread.joinable()) thread.join();
+#ifdef __linux__
+            if (inotifyFd >= 0) io::closeFd(inotifyFd);
+            if (wakeFd >= 0) io::closeFd(wakeFd);
+#endif
+        }
+
+        ConfigFileWatcher(const ConfigFileWatcher &) = delete;
+        ConfigFileWatcher &operator=(const ConfigFileWatcher &) = delete;
+
+    private:
+#ifdef __linux__
+        void watchEvents() {
+            alignas(inotify_event) char buffer[4096];
+            pollfd fds[2] = {{inotifyFd, POLLIN, 0}, {wakeFd, POLLIN, 0}};
+            while (true) {
+                if (::poll(fds, 2, -1) < 0) {
+                    if (errno == EINTR) continue;
+                    return;
+                }
+                if (fds[1].revents) return;
+                // һαܲ¼ֻ¼һ
+                bool changed = false;
+                ssize_t length;
+                while ((length = ::read(inotifyFd, buffer, sizeof(buffer))) > 0) {
+                    for (char *p = buffer; p < buffer + length;) {
+                        auto *event = reinterpret_cast<inotify_event *>(p);
+                        if (event->len > 0 && fileName == event->name) changed = true;
+                        p += sizeof(inotify_event) + event->len;
+                    }
+                }
+                if (changed) onChange();
+            }
+        }
+#endif
+
+        void pollModifiedTime() {
+            std::error_code ec;
+            auto lastWrite = std::filesystem::last_write_time(path, ec);
+            std::unique_lock<std::mutex> lock(mutex);
+            while (!cond.wait_for(lock, kPollInterval, [this] { return stopping; })) {
+                auto current = std::filesystem::last_write_time(path, ec);
+                if (ec || current == lastWrite) continue;
+                lastWrite = current;
+                lock.unlock();
+                onChange();
+                lock.lock();
+            }
+        }
+
+        std::string path;
+        std::function<void()> onChange;
+        std::mutex mutex;
+        std::condition_variable cond;
+        bool stopping = false;
+#ifdef __linux__
+        std::string fileName;
+        int inotifyFd = -1;
+        int wakeFd = -1;// ʱдԻ poll
+#endif
+        std::thread thread;
+    };
+
+#ifndef _WIN32
+    // ̹ļ¼ shm_open ĹڴУ߽д룬ռ̵߽ȡ
+    // λŵ÷̳߳صע뻷ͬһ۵ϢռĶۣ׸
+    class SharedRing {
+    public:
+        static constexpr uint64_t kMagic = 0x31474e49524c4250;// "PBLRING1"
+        static constexpr size_t kSlotSize = 256;
+        static constexpr size_t kMaxSlotsPerRecord = 64;// Ϣض
+        // Ԥٳûд claim ĲλʱΪ֮˳
+        static constexpr std::chrono::seconds kClaimTimeout{2};
+
+        // ׸֮ĲҲʹͬĽṹֻе payload
+        struct alignas(64) Slot {
+            std::atomic<uint64_t> sequence;
+            std::atomic<uint64_t> claim;// Ԥд (pid << 16) | дǰʱռ߾ݴ
+            int64_t wallNanos;
+            uint64_t threadId;
+            uint32_t length;
+            uint8_t level;
+            char payload[kSlotSize - 37];
+        };
+        static_assert(sizeof(Slot) == kSlotSize);
+        static constexpr size_t kPayloadSize = sizeof(Slot::payload);
+
+        struct Header {
+            uint64_t magic;
+            uint64_t slotCount;
+            alignas(64) std::atomic<uint64_t> tail;// һԤλ
+            alignas(64) std::atomic<uint64_t> head;// ռһȡλ
+            alignas(64) std::atomic<uint32_t> wakeSequence;// ռʱ futex ȴ
+            std::atomic<uint32_t> collectorWaiting;
+            std::atomic<uint64_t> dropped;// ʱļ¼ռȡ߲㱨
+            int64_t collectorPid;
+        };
+        static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free,
+                      "ڴеԭӱ");
+
+        struct Entry {
+            LogLevel level;
+            int64_t wallNanos;
+            uint64_t threadId;
+        };
+
+        // ռߴͬľɹڴ棨ϴ쳣˳µģɾslotCount ȡΪ 2 
+        static std::unique_ptr<SharedRing> create(const std::string &name, size_t slotCount) {
+            slotCount = std::bit_ceil(std::max<size_t>(slotCount, kMaxSlotsPerRecord * 2));
+            size_t size = sizeof(Header) + slotCount * sizeof(Slot);
+            ::shm_unlink(name.c_str());
+            int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+            if (fd < 0) return nullptr;
+            if (::ftruncate(fd, static_cast<off_t>(size)) != 0) {
+                ::close(fd);
+                ::shm_unlink(name.c_str());
+                return nullptr;
+            }
+            std::unique_ptr<SharedRing> ring = map(fd, size, name, true);
+            if (!ring) {
+                ::shm_unlink(name.c_str());
+                return nullptr;
+            }
+            // ftruncate õڴȫΪ 0ֻòλţдħ
+            Header *header = ring->header;
+            header->slotCount = slotCount;
+            header->collectorPid = static_cast<int64_t>(::getpid());
+            for (size_t i = 0; i < slotCount; ++i) ring->slots[i].sequence.store(i, std::memory_order_relaxed);
+            ring->mask = slotCount - 1;
+            std::atomic_ref<uint64_t>(header->magic).store(kMagic, std::memory_order_release);
+            return ring;
+        }
+
+        // ߴռߴĻ
+        static std::unique_ptr<SharedRing> attach(const std::string &name) {
+            int fd = ::shm_open(name.c_str(), O_RDWR, 0);
+            if (fd < 0) return nullptr;
+            struct stat info{};
+            if (::fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(Header)) {
+                ::close(fd);
+                return nullptr;
+            }
+            size_t size = static_cast<size_t>(info.st_size);
+            std::unique_ptr<SharedRing> ring = map(fd, size, name, false);
+            if (!ring) return nullptr;
+            Header *header = ring->header;
+            if (std::atomic_ref<uint64_t>(header->magic).load(std::memory_order_acquire) != kMagic ||
+                sizeof(Header) + header->slotCount * sizeof(Slot) != size || !std::has_single_bit(header->slotCount)) {
+                return nullptr;
+            }
+            ring->mask = header->slotCount - 1;
+            return ring;
+        }
+
+        ~SharedRing() {
+            ::munmap(header, mappedSize);
+            if (owner) ::shm_unlink(name.c_str());
+        }
+
+        SharedRing(const SharedRing &) = delete;
+        SharedRing &operator=(const SharedRing &) = delete;
+
+        // дһ¼ʱȴռڳռ䣬ڶһ¼
+        // ֻռѾ˳ʱŶ false
+        bool push(LogLevel level, int64_t wallNanos, uint64_t threadId, std::string_view message) {
+            size_t count = std::max<size_t>(1, (message.size() + kPayloadSize - 1) / kPayloadSize);
+            if (count > kMaxSlotsPerRecord) {
+                count = kMaxSlotsPerRecord;
+                message = message.substr(0, count * kPayloadSize);
+            }
+            // ռ߰˳ͷŲλһۿʱǰҲһ
+            uint64_t position = header->tail.load(std::memory_order_relaxed);
+            while (true) {
+                uint64_t last = position + count - 1;
+                uint64_t sequence = slots[last & mask].sequence.load(std::memory_order_acquire);
+                auto diff = static_cast<int64_t>(sequence - last);
+                if (diff == 0) {
+                    if (header->tail.compare_exchange_weak(position, position + count, std::memory_order_relaxed)) break;
+                } else if (diff < 0) {
+                    if (!waitForSpace()) {
+                        header->dropped.fetch_add(1, std::memory_order_relaxed);
+                        return false;
+                    }
+                    position = header->tail.load(std::memory_order_relaxed);
+                } else {
+                    position = header->tail.load(std::memory_order_relaxed);
+                }
+            }
+
+            Slot &first = slots[position & mask];
+            first.claim.store((static_cast<uint64_t>(::getpid()) << 16) | count, std::memory_order_relaxed);
+            first.wallNanos = wallNanos;
+            first.threadId = threadId;
+            first.length = static_cast<uint32_t>(message.size());
+            first.level = static_cast<uint8_t>(level);
+            // ȷۣٷ׸ۣռ߿׸۾ʱ¼ѿɶ
+            for (size_t i = count; i-- > 0;) {
+                Slot &slot = slots[(position + i) & mask];
+                size_t offset = i * kPayloadSize;
+                if (offset < message.size()) std::memcpy(slot.payload, message.data() + offset, std::min(kPayloadSize, message.size() - offset));
+                slot.sequence.store(position + i + 1, std::memory_order_release);
+            }
+
+            std::atomic_thread_fence(std::memory_order_seq_cst);// ռǰļԣ©
+            if (header->collectorWaiting.load(std::memory_order_relaxed)) {
+                header->wakeSequence.fetch_add(1, std::memory_order_relaxed);
+                futexWake(&header->wakeSequence);
+            }
+            return true;
+        }
+
+        // ռȡһ¼ûоļ¼ʱ false
+        bool pop(Entry &entry, std::string &message) {
+            uint64_t position = header->head.load(std::memory_order_relaxed);
+            Slot &first = slots[position & mask];
+            if (first.sequence.load(std::memory_order_acquire) != position + 1) return false;
+            size_t count = static_cast<size_t>(first.claim.load(std::memory_order_relaxed) & 0xFFFF);
+            entry = {static_cast<LogLevel>(first.level), first.wallNanos, first.threadId};
+            size_t length = first.length;
+            message.clear();
+            for (size_t i = 0; i < count; ++i) {
+                Slot &slot = slots[(position + i) & mask];
+                size_t offset = i * kPayloadSize;
+                if (offset < length) message.append(slot.payload, std::min(kPayloadSize, length - offset));
+            }
+            release(position, count);
+            return true;
+        }
+
+        // ȡλóʱûоʱãԤĽѾ˳ЩۣǷ
+        bool skipAbandoned() {
+            uint64_t position = header->head.load(std::memory_order_relaxed);
+            uint64_t tail = header->tail.load(std::memory_order_relaxed);
+            if (tail == position) return false;
+            Slot &first = slots[position & mask];
+            if (first.sequence.load(std::memory_order_acquire) == position + 1) return false;
+            uint64_t claim = first.claim.load(std::memory_order_relaxed);
+            if (claim != 0) {
+                auto pid = static_cast<pid_t>(claim >> 16);
+                if (::kill(pid, 0) == 0 || errno != ESRCH) return false;
+                release(position, static_cast<size_t>(claim & 0xFFFF));
+                header->dropped.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+            // Ԥûд claimֻǱȳȥҲ֮˳ֻܵȴʱ
+            auto now = std::chrono::steady_clock::now();
+            if (position != stalledPosition) {
+                stalledPosition = position;
+                stalledTail = tail;
+                stalledSince = now;
+                return false;
+            }
+            if (now - stalledSince < kClaimTimeout) return false;
+            // ޴ӵ֪һд claim Ĳۣһ¼׸ۡʱڼû claim Ĳ
+            // ͬ˳ߣһһ¼Ĳʣµһ
+            uint64_t end = std::min(stalledTail, position + kMaxSlotsPerRecord);
+            uint64_t next = position + 1;
+            while (next < end && slots[next & mask].claim.load(std::memory_order_relaxed) == 0) ++next;
+            release(position, static_cast<size_t>(next - position));
+            header->dropped.fetch_add(1, std::memory_order_relaxed);
+            stalledPosition = UINT64_MAX;
+            return true;
+        }
+
+        // ռڻΪʱȴдѣʱ󷵻
+        void wait(std::chrono::milliseconds timeout) {
+            uint32_t observed = header->wakeSequence.load(std::memory_order_relaxed);
+            header->collectorWaiting.store(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!ready()) futexWait(&header->wakeSequence, observed, timeout);
+            header->collectorWaiting.store(0, std::memory_order_relaxed);
+        }
+
+        // ڵȴռߣֹͣռ
+        void wake() {
+            header->wakeSequence.fetch_add(1, std::memory_order_relaxed);
+            futexWake(&header->wakeSequence);
+        }
+
+        bool ready() const {
+            uint64_t position = header->head.load(std::memory_order_relaxed);
+            return slots[position & mask].sequence.load(std::memory_order_acquire) == position + 1;
+        }
+
+        uint64_t takeDropped() { return header->dropped.exchange(0, std::memory_order_relaxed); }
+
+        // ߵȴǰдļ¼ռȡߣռѾ˳ʱ
+        void waitCollected() {
+            uint64_t target = header->tail.load(std::memory_order_acquire);
+            auto collector = static_cast<pid_t>(header->collectorPid);
+            while (static_cast<int64_t>(header->head.load(std::memory_order_acquire) - target) < 0) {
+                if (::kill(collector, 0) != 0 && errno == ESRCH) return;
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+        }
+
+    private:
+        SharedRing(Header *header, size_t mappedSize, std::string name, bool owner)
+            : header(header), slots(reinterpret_cast<Slot *>(header + 1)), mappedSize(mappedSize), name(std::move(name)), owner(owner) {}
+
+        static std::unique_ptr<SharedRing> map(int fd, size_t size, const std::string &name, bool owner) {
+            void *address = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (address == MAP_FAILED) return nullptr;
+            return std::unique_ptr<SharedRing>(new SharedRing(static_cast<Header *>(address), size, name, owner));
+        }
+
+        // ʱó CPU ռߣռ߽Ѿʱ false
+        bool waitForSpace() {
+            wake();
+            if (::kill(static_cast<pid_t>(header->collectorPid), 0) != 0 && errno == ESRCH) return false;
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+            return true;
+        }
+
+        void release(uint64_t position, size_t count) {
+            for (size_t i = 0; i < count; ++i) {
+                Slot &slot = slots[(position + i) & mask];
+                slot.claim.store(0, std::memory_order_relaxed);
+                slot.sequence.store(position + i + header->slotCount, std::memory_order_release);
+            }
+            header->head.store(position + count, std::memory_order_release);
+        }
+
+        // ̵ȴʹ std::atomic::wait futex ֻڽЧLinux ֱӵù futex
+        static void futexWait(std::atomic<uint32_t> *word, uint32_t expected, std::chrono::milliseconds timeout) {
+#ifdef __linux__
+            timespec ts{static_cast<time_t>(timeout.count() / 1000), static_cast<long>(timeout.count() % 1000) * 1000000};
+            ::syscall(SYS_futex, reinterpret_cast<uint32_t *>(word), FUTEX_WAIT, expected, &ts, nullptr, 0);
+#else
+            (void) word;
+            (void) expected;
+            std::this_thread::sleep_for(std::min(timeout, std::chrono::milliseconds(1)));
+#endif
+        }
+
+        static void futexWake(std::atomic<uint32_t> *word) {
+#ifdef __linux__
+            ::syscall(SYS_futex, reinterpret_cast<uint32_t *>(word), FUTEX_WAKE, 1, nullptr, nullptr, 0);
+#else
+            (void) word;
+#endif
+        }
+
+        Header *header;
+        Slot *slots;
+        uint64_t mask = 0;
+        size_t mappedSize;
+        std::string name;
+        bool owner;// ʱɾڴ
+        // ռ˽Уȡλͣ claim Ϊ 0 Ĳϵʼʱ͵ʱ tail
+        uint64_t stalledPosition = UINT64_MAX;
+        uint64_t stalledTail = 0;
+        std::chrono::steady_clock::time_point stalledSince{};
+    };
+
+    // ռߣڵ߳аѹеļ¼ת뱾̵ĶУɱ̵ĺ̨߳ͳһת
+    class SharedRingCollector {
+    public:
+        using Drain = std::function<void(SharedRing &ring, const std::atomic<bool> &stopping)>;
+
+        SharedRingCollector(std::unique_ptr<SharedRing> ring, Drain drain)
+            : ring(std::move(ring)), ownerPid(::getpid()) {
+            thread = std::thread([this, drain = std::move(drain)] { drain(*this->ring, stopping); });
+        }
+
+        // fork ӽûռ̶̣߳߳ƵĶѶϣڴɾ
+        ~SharedRingCollector() {
+            stopping.store(true, std::memory_order_release);
+            if (::getpid() != ownerPid) {
+                new std::thread(std::move(thread));
+                (void) ring.release();
+                return;
+            }
+            ring->wake();
+            if (thread.joinable()) thread.join();
+        }
+
+        SharedRingCollector(const SharedRingCollector &) = delete;
+        SharedRingCollector &operator=(const SharedRingCollector &) = delete;
+
+    private:
+        std::unique_ptr<SharedRing> ring;
+        std::atomic<bool> stopping{false};
+        pid_t ownerPid;
+        std::thread thread;
+    };
+#endif
+
+#ifndef _WIN32
+    // ֱд־ļ鰴ҳݴʹą̰̃߳ݸƽǰ飬д󽻸д̣߳
+    // Լһ飬ֻ鶼ʱŵȴˢʱһҳĽβдļʱҳ룬
+    // ´дһҳͷǡʵʳȼ validLength УرʱضϵóȣʱźŴض
+    class DirectFileWriter {
+    public:
+        static constexpr size_t kAlignment = 4096;
+
+        // fd ɵ÷򿪺͹رգsize ļǰĳȡرպͱʱļѽضϵʵʳȣ
+        // β '\0' ûݣܾݴƶϳ
+        DirectFileWriter(int fd, uint64_t size, size_t stagingSize)
+            : fd(fd), capacity(std::max(kAlignment, (stagingSize + kAlignment - 1) / kAlignment * kAlignment)) {
+            for (Block &block: blocks) block.data = static_cast<char *>(::operator new(capacity, std::align_val_t(kAlignment)));
+            Block &block = blocks[active];
+            block.offset = size / kAlignment * kAlignment;
+            size_t tail = static_cast<size_t>(size - block.offset);
+            if (tail > 0) {
+                ssize_t got = ::pread(fd, block.data, kAlignment, static_cast<off_t>(block.offset));
+                block.used = got > 0 ? std::min(tail, static_cast<size_t>(got)) : 0;
+            }
+            logicalSize = block.offset + block.used;
+            extent = size;
+            written.store(logicalSize, std::memory_order_relaxed);
+            thread = std::thread(&DirectFileWriter::run, this);
+        }
+
+        ~DirectFileWriter() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            cond.notify_all();
+            if (thread.joinable()) thread.join();
+            for (Block &block: blocks) ::operator delete(block.data, std::align_val_t(kAlignment));
+        }
+
+        DirectFileWriter(const DirectFileWriter &) = delete;
+        DirectFileWriter &operator=(const DirectFileWriter &) = delete;
+
+        uint64_t size() const { return logicalSize; }
+
+        // ʱã첽źŰȫȥд֮Ĳ㣬֮ݿֱ׷
+        void truncateToWritten() const { io::truncate(fd, written.load(std::memory_order_acquire)); }
+
+        void append(std::string_view data) {
+            while (!data.empty()) {
+                Block &block = blocks[active];
+                size_t chunk = std::min(data.size(), capacity - block.used);
+                std::memcpy(block.data + block.used, data.data(), chunk);
+                block.used += chunk;
+                logicalSize += chunk;
+                data.remove_prefix(chunk);
+                if (block.used == capacity) submit();
+            }
+        }
+
+        // дݣһҳĽβ㡣tail ݲύĽβѹδ֮֡һд
+        // ļȣ´дʱǡ false ʾдʧ
+        bool flush(std::string_view tail = {}) {
+            waitIdle();
+            Block &block = blocks[active];
+            if (block.used > 0 || !tail.empty()) {
+                size_t length = block.used + tail.size();
+                size_t padded = (length + kAlignment - 1) / kAlignment * kAlignment;
+                char *data = block.data;
+                if (padded > capacity) {// βݴʱ
+                    data = static_cast<char *>(::operator new(padded, std::align_val_t(kAlignment)));
+                    std::memcpy(data, block.data, block.used);
+                }
+                if (!tail.empty()) std::memcpy(data + block.used, tail.data(), tail.size());
+                std::memset(data + length, 0, padded - length);
+                if (!writeBlock(data, padded, block.offset)) failed = true;
+                if (data != block.data) ::operator delete(data, std::align_val_t(kAlignment));
+                written.store(block.offset + length, std::memory_order_release);
+                // ֮ǰдĽβʱȥĲֽ֣ڻᱻȡ
+                uint64_t end = block.offset + padded;
+                if (end < extent) io::truncate(fd, end);
+                extent = end;
+                // ѾдҳдֻһҳĲ
+                size_t written = block.used / kAlignment * kAlignment;
+                std::memmove(block.data, block.data + written, block.used - written);
+                block.offset += written;
+                block.used -= written;
+            }
+            return !failed.load(std::memory_order_relaxed);
+        }
+
+        // رǰãдʣݲȥβĲԤռ
+        bool finish() {
+            bool ok = flush();
+            io::truncate(fd, logicalSize);
+            return ok;
+        }
+
+    private:
+        struct Block {
+            char *data = nullptr;
+            size_t used = 0;
+            uint64_t offset = 0;// 鿪ͷļеλãǰҳ
+        };
+
+        bool writeBlock(const char *data, size_t length, uint64_t offset) {
+            while (length > 0) {
+                ssize_t written = ::pwrite(fd, data, length, static_cast<off_t>(offset));
+                if (written < 0 && errno == EINTR) continue;
+                if (written <= 0) {
+                    reportError();
+                    return false;
+                }
+                data += written;
+                length -= static_cast<size_t>(written);
+                offset += static_cast<uint64_t>(written);
+            }
+            return true;
+        }
+
+        void reportError() {
+            if (!failed.exchange(true, std::memory_order_relaxed)) std::cerr << "Direct log write failed: " << strerror(errno) << std::endl;
+        }
+
+        // ǰдд̣߳һклȥ
+        void submit() {
+            waitIdle();
+            Block &full = blocks[active];
+            Block &next = blocks[active ^ 1];
+            next.offset = full.offset + full.used;
+            extent = std::max(extent, next.offset);
+            next.used = 0;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                pending = &full;
+            }
+            cond.notify_all();
+            active ^= 1;
+        }
+
+        void waitIdle() {
+            std::unique_lock<std::mutex> lock(mutex);
+            cond.wait(lock, [this] { return pending == nullptr; });
+        }
+
+        void run() {
+            std::unique_lock<std::mutex> lock(mutex);
+            for (;;) {
+                cond.wait(lock, [this] { return pending != nullptr || stopping; });
+                if (pending == nullptr) return;
+                Block *block = pending;
+                lock.unlock();
+                // дûв㣻ˢʱдδύβѱһ鸲ǣ֮ĲֲЧ
+                if (writeBlock(block->data, block->used, block->offset)) written.store(block->offset + block->used, std::memory_order_release);
+                lock.lock();
+                pending = nullptr;
+                cond.notify_all();
+            }
+        }
+
+        int fd;
+        size_t capacity;
+        Block blocks[2];
+        int active = 0;
+        uint64_t logicalSize = 0;
+        uint64_t extent = 0;                // дԶλã㣩
+        std::atomic<uint64_t> written{0};   // ļЧݵĳȣ㣬·ض
+        std::atomic<bool> failed{false};
+
+        std::mutex mutex;
+        std::condition_variable cond;
+        Block *pending = nullptr;// д̵߳Ŀ飬дÿ
+        bool stopping = false;
+        std::thread thread;
+    };
+#else
+    // Windows ϲֱ֧д룬openLogFile ᴴö
+    class DirectFileWriter {
+    public:
+        uint64_t size() const { return 0; }
+        void append(std::string_view) {}
+        bool flush(std::string_view = {}) { return true; }
+        bool finish() { return true; }
+    };
+#endif
+
+#ifndef _WIN32
+    // ׽Ѽ¼͸ռsyslog ػ̻еռ񣩡
+    // ֻ̨߳Ѽ¼׷ӵ壬ɶķ̴̨߳߳͡Ӳȴ׽
+    class SocketSink {
+    public:
+        using Stats = SocketSinkStats;
+
+        explicit SocketSink(SocketSinkOptions options) : options(std::move(options)) {
+            char name[256] = {};
+            if (::gethostname(name, sizeof(name) - 1) != 0 || name[0] == '\0') std::strcpy(name, "-");
+            hostname = name;
+            processId = std::to_string(::getpid());
+            thread = std::thread(&SocketSink::run, this);
+        }
+
+        // ֹͣǰʣļ¼ӲʱֱӶ
+        ~SocketSink() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            cond.notify_all();
+            if (thread.joinable()) thread.join();
+            if (fd >= 0) ::close(fd);
+        }
+
+        SocketSink(const SocketSink &) = delete;
+        SocketSink &operator=(const SocketSink &) = delete;
+
+        // ֻɺ̵̨߳ãwrite һ¼submit ѱ¼̣߳ض
+        void write(LogLevel level, int64_t wallNanos, std::string_view prefix, std::string_view message, std::string_view suffix) {
+            if (options.framing == SocketFraming::SYSLOG) {
+                appendSyslog(level, wallNanos, message);
+            } else {
+                // ԭʽ4 ֽС˳ȣ֮һУУ
+                auto length = static_cast<uint32_t>(prefix.size() + message.size() + suffix.size());
+                char header[4] = {static_cast<char>(length), static_cast<char>(length >> 8), static_cast<char>(length >> 16), static_cast<char>(length >> 24)};
+                filling.data.append(header, sizeof(header)).append(prefix).append(message).append(suffix);
+            }
+            filling.ends.push_back(filling.data.size());
+        }
+
+        uint64_t submit() {
+            if (filling.ends.empty()) return 0;
+            uint64_t dropped = 0;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                // ռϻӶϿʱŲµ¼¼ֱӶ̨߳
+                size_t room = options.bufferLimit > pending.data.size() ? options.bufferLimit - pending.data.size() : 0;
+                if (filling.data.size() > room) {
+                    size_t accepted = static_cast<size_t>(std::upper_bound(filling.ends.begin(), filling.ends.end(), room) - filling.ends.begin());
+                    dropped = filling.ends.size() - accepted;
+                    stats.dropped += dropped;
+                    filling.data.resize(accepted == 0 ? 0 : filling.ends[accepted - 1]);
+                    filling.ends.resize(accepted);
+                }
+                if (pending.ends.empty()) {
+                    std::swap(pending, filling);
+                } else if (!filling.ends.empty()) {
+                    size_t base = pending.data.size();
+                    pending.data.append(filling.data);
+                    for (size_t end: filling.ends) pending.ends.push_back(base + end);
+                }
+            }
+            filling.clear();
+            cond.notify_one();
+            return dropped;
+        }
+
+        Stats getStats() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return stats;
+        }
+
+    private:
+        // ¼βӴţends Ϊÿ¼Ľλ
+        struct Frames {
+            std::string data;
+            std::vector<size_t> ends;
+
+            void clear() {
+                data.clear();
+                ends.clear();
+            }
+        };
+
+        static constexpr size_t kMaxMessagesPerCall = 256;
+        static constexpr timeval kSendTimeout{1, 0};// ռ򲻶ȡʱôãֹ֤ͣʱһֱȴ
+
+        // RFC 5424<PRI>1 ʱ  Ӧ ̺ - - Ϣʽ׽ְ RFC 6587 ǰϳ
+        void appendSyslog(LogLevel level, int64_t wallNanos, std::string_view message) {
+            static constexpr int severities[] = {7, 6, 4, 3, 2, 7};// DEBUG INFO WARN ERROR FATAL TRACE
+            int priority = options.facility * 8 + severities[static_cast<size_t>(level)];
+            std::time_t second = static_cast<std::time_t>(wallNanos / 1000000000);
+            if (second != cachedSecond) {
+                std::tm tm{};
+                gmtime_r(&second, &tm);
+                char buffer[32];
+                size_t length = std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%S", &tm);
+                cachedTime.assign(buffer, length);
+                cachedSecond = second;
+            }
+            scratch.clear();
+            std::format_to(std::back_inserter(scratch), "<{}>1 {}.{:06}Z {} {} {} - - ", priority, cachedTime, (wallNanos % 1000000000) / 1000,
+                           hostname, options.appName.empty() ? std::string_view("-") : std::string_view(options.appName), processId);
+            if (options.type == SocketType::STREAM) {
+                std::format_to(std::back_inserter(filling.data), "{} ", scratch.size() + message.size());
+            }
+            filling.data.append(scratch).append(message);
+        }
+
+        void run() {
+            Frames sending;
+            size_t next = 0;// sending һҪ͵ļ¼
+            while (true) {
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    if (next == sending.ends.size()) {
+                        cond.wait(lock, [this] { return stopping || !pending.ends.empty(); });
+                        if (pending.ends.empty()) return;// ֹͣûʣ
+                        sending.clear();
+                        std::swap(sending, pending);
+                        next = 0;
+                    }
+                }
+                if (fd < 0 && !connect()) {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    if (stopping) {
+                        stats.dropped += sending.ends.size() - next + pending.ends.size();
+                        return;
+                    }
+                    cond.wait_for(lock, options.reconnectInterval, [this] { return stopping; });
+                    continue;
+                }
+                next = options.type == SocketType::DATAGRAM ? sendDatagrams(sending, next) : sendStream(sending, next);
+            }
+        }
+
+        bool connect() {
+            sockaddr_un address{};
+            address.sun_family = AF_UNIX;
+            if (options.path.size() >= sizeof(address.sun_path)) return false;
+            std::memcpy(address.sun_path, options.path.c_str(), options.path.size() + 1);
+            int socketType = options.type == SocketType::DATAGRAM ? SOCK_DGRAM : SOCK_STREAM;
+            fd = ::socket(AF_UNIX, socketType | SOCK_CLOEXEC, 0);
+            if (fd < 0) return false;
+            ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &kSendTimeout, sizeof(kSendTimeout));
+            if (::connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0) {
+                ::close(fd);
+                fd = -1;
+                return false;
+            }
+            if (everConnected) {
+                std::lock_guard<std::mutex> lock(mutex);
+                ++stats.reconnects;
+            }
+            everConnected = true;
+            return true;
+        }
+
+        void disconnect() {
+            ::close(fd);
+            fd = -1;
+        }
+
+        std::string_view frame(const Frames &frames, size_t index) const {
+            size_t begin = index == 0 ? 0 : frames.ends[index - 1];
+            return std::string_view(frames.data).substr(begin, frames.ends[index] - begin);
+        }
+
+        // ÿ¼һݱLinux һ sendmmsg Ͷ
+        size_t sendDatagrams(const Frames &frames, size_t next) {
+            iovec iov[kMaxMessagesPerCall];
+            size_t count = std::min(kMaxMessagesPerCall, frames.ends.size() - next);
+            for (size_t i = 0; i < count; ++i) {
+                std::string_view data = frame(frames, next + i);
+                iov[i] = {const_cast<char *>(data.data()), data.size()};
+            }
+#ifdef __linux__
+            mmsghdr messages[kMaxMessagesPerCall] = {};
+            for (size_t i = 0; i < count; ++i) {
+                messages[i].msg_hdr.msg_iov = &iov[i];
+                messages[i].msg_hdr.msg_iovlen = 1;
+            }
+            int sent = ::sendmmsg(fd, messages, static_cast<unsigned>(count), MSG_NOSIGNAL);
+#else
+            int sent = 0;
+            for (; sent < static_cast<int>(count); ++sent) {
+                msghdr message{};
+                message.msg_iov = &iov[sent];
+                message.msg_iovlen = 1;
+                if (::sendmsg(fd, &message, MSG_NOSIGNAL) < 0) {
+                    if (sent == 0) sent = -1;
+                    break;
+                }
+            }
+#endif
+            std::lock_guard<std::mutex> lock(mutex);
+            ++stats.sendCalls;
+            if (sent > 0) {
+                stats.sent += static_cast<uint64_t>(sent);
+                return next + static_cast<size_t>(sent);
+            }
+            if (errno == EINTR) return next;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return giveUpIfStopping(frames, next);
+            if (errno == EMSGSIZE) {
+                ++stats.dropped;// ݱޣһ
+                return next + 1;
+            }
+            disconnect();
+            return next;
+        }
+
+        // ʽ׽֣ kMaxMessagesPerCall ¼һ sendд
+        size_t sendStream(const Frames &frames, size_t next) {
+            size_t count = std::min(kMaxMessagesPerCall, frames.ends.size() - next);
+            size_t begin = next == 0 ? 0 : frames.ends[next - 1];
+            size_t end = frames.ends[next + count - 1];
+            // ¼ data ģϴβдλü
+            ssize_t written = ::send(fd, frames.data.data() + begin + streamOffset, end - begin - streamOffset, MSG_NOSIGNAL);
+            std::lock_guard<std::mutex> lock(mutex);
+            ++stats.sendCalls;
+            if (written < 0) {
+                if (errno == EINTR) return next;
+                if (errno == EAGAIN || errno == EWOULDBLOCK) return giveUpIfStopping(frames, next);
+                // ѷһֵļ¼ͷطշ֡
+                streamOffset = 0;
+                disconnect();
+                return next;
+            }
+            size_t position = begin + streamOffset + static_cast<size_t>(written);
+            while (next < frames.ends.size() && frames.ends[next] <= position) {
+                ++next;
+                ++stats.sent;
+            }
+            streamOffset = position - (next == 0 ? 0 : frames.ends[next - 1]);
+            return next;
+        }
+
+        // ͳʱʱԺԣֹͣʱʣļ¼ʱ mutex
+        size_t giveUpIfStopping(const Frames &frames, size_t next) {
+            if (!stopping) return next;
+            stats.dropped += frames.ends.size() - next + pending.ends.size();
+            pending.clear();
+            streamOffset = 0;
+            return frames.ends.size();
+        }
+
+        SocketSinkOptions options;
+        std::string hostname;
+        std::string processId;
+        Frames filling;// ֻɺ̷̨߳
+        std::string scratch;
+        std::string cachedTime;
+        std::time_t cachedSecond = -1;
+
+        mutable std::mutex mutex;
+        std::condition_variable cond;
+        Frames pending;// ̡߳δʼ͵ļ¼
+        Stats stats;
+        bool stopping = false;
+
+        int fd = -1;// ֻɷ̷߳
+        bool everConnected = false;
+        size_t streamOffset = 0;// ǰ¼Ѿֽ
+        std::thread thread;
+    };
+#endif
+
+    namespace configfile {
+        inline std::string_view trim(std::string_view text) {
+            constexpr std::string_view spaces = " \t\r\n";
+            size_t begin = text.find_first_not_of(spaces);
+            if (begin == std::string_view::npos) return {};
+            return text.substr(begin, text.find_last_not_of(spaces) - begin + 1);
+        }
+
+        inline bool parseLevel(std::string_view value, LogLevel &level) {
+            static constexpr std::pair<std::string_view, LogLevel> names[] = {
+                    {"DEBUG", LogLevel::DEBUG}, {"INFO", LogLevel::INFO}, {"WARN", LogLevel::WARN},
+                    {"ERROR", LogLevel::ERROR}, {"FATAL", LogLevel::FATAL}, {"TRACE", LogLevel::TRACE}};
+            for (const auto &[name, candidate]: names) {
+                if (name == value) {
+                    level = candidate;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        inline bool parseType(std::string_view value, LogType &type) {
+            static constexpr std::pair<std::string_view, LogType> names[] = {
+                    {"CONSOLE", LogType::CONSOLE}, {"FILE", LogType::FILE}, {"BOTH", LogType::BOTH}, {"NONE", LogType::NONE}};
+            for (const auto &[name, candidate]: names) {
+                if (name == value) {
+                    type = candidate;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        inline bool parseBool(std::string_view value, bool &flag) {
+            if (value == "true" || value == "on" || value == "1") flag = true;
+            else if (value == "false" || value == "off" || value == "0") flag = false;
+            else return false;
+            return true;
+        }
+
+        inline bool parseCompression(std::string_view value, FileCompression &compression) {
+            static constexpr std::pair<std::string_view, FileCompression> names[] = {
+                    {"NONE", FileCompression::NONE}, {"LZ", FileCompression::LZ}, {"ZLIB", FileCompression::ZLIB}};
+            for (const auto &[name, candidate]: names) {
+                if (name == value) {
+                    compression = candidate;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        inline bool parseOutputFormat(std::string_view value, OutputFormat &format) {
+            static constexpr std::pair<std::string_view, OutputFormat> names[] = {
+                    {"TEXT", OutputFormat::TEXT}, {"SINGLE_LINE", OutputFormat::SINGLE_LINE}, {"JSON", OutputFormat::JSON}};
+            for (const auto &[name, candidate]: names) {
+                if (name == value) {
+                    format = candidate;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // Ǹɴ K/M/G ׺ 1024 λ
+        inline bool parseSize(std::string_view value, size_t &size) {
+            size_t multiplier = 1;
+            if (!value.empty()) {
+                switch (value.back()) {
+                    case 'K': multiplier = size_t(1) << 10; break;
+                    case 'M': multiplier = size_t(1) << 20; break;
+                    case 'G': multiplier = size_t(1) << 30; break;
+                    default: break;
+                }
+                if (multiplier != 1) value.remove_suffix(1);
+            }
+            if (value.empty()) return false;
+            size_t number = 0;
+            for (char c: value) {
+                if (c < '0' || c > '9') return false;
+                size_t digit = static_cast<size_t>(c - '0');
+                if (number > (SIZE_MAX - digit) / 10) return false;// 
+                number = number * 10 + digit;
+            }
+            if (number > SIZE_MAX / multiplier) return false;
+            size = number * multiplier;
+            return true;
+        }
+
+        inline bool apply(LogConfig &config, std::string_view key, std::string_view value) {
+            if (key == "level") return parseLevel(value, config.level);
+            if (key == "type") return parseType(value, config.type);
+            if (key == "maxFileSize") return parseSize(value, config.maxFileSize);
+            if (key == "maxFileCount") return parseSize(value, config.maxFileCount);
+            if (key == "logPath") config.logPath = value;
+            else if (key == "logName") config.logName = value;
+            else if (key == "timeFormat") config.timeFormat = value;
+            else if (key == "prefixFormat") config.prefixFormat = value;
+            else if (key == "pattern") config.pattern = value;
+            else if (key == "outputFormat") return parseOutputFormat(value, config.outputFormat);
+            else if (key == "indexRecords") return parseSize(value, config.fileIndex.records);
+            else if (key == "indexIntervalMs") {
+                size_t milliseconds = 0;
+                if (!parseSize(value, milliseconds)) return false;
+                config.fileIndex.interval = std::chrono::milliseconds(milliseconds);
+            } else if (key == "compression") return parseCompression(value, config.compression.codec);
+            else if (key == "frameSize") return parseSize(value, config.compression.frameSize);
+            else if (key == "directIo") return parseBool(value, config.fileIo.directIo);
+            else if (key == "preallocate") return parseBool(value, config.fileIo.preallocate);
+            else if (key == "stagingSize") return parseSize(value, config.fileIo.stagingSize);
+            else return false;
+            return true;
+        }
+    }// namespace configfile
+
+    // ʼ̬Ա
+    inline ConfigStore PebbleLog::configStore;
+    inline std::atomic<LogLevel> PebbleLog::levelFilter{LogConfig{}.level};
+    inline std::unique_ptr<ConfigFileWatcher> PebbleLog::configWatcher;
+    inline std::atomic<LogType> PebbleLog::crashLogType{LogType::CONSOLE};
+    inline std::mutex PebbleLog::logMutex;
+    inline std::vector<PebbleLog::LogRecord> PebbleLog::logQueue;// 徲̬Ա logQueue
+    inline Immortal<std::mutex> PebbleLog::queueMutexStorage;
+    inline Immortal<std::condition_variable> PebbleLog::queueCondStorage;
+    inline std::mutex &PebbleLog::queueMutex = queueMutexStorage.value;
+    inline std::condition_variable &PebbleLog::queueCond = queueCondStorage.value;
+    inline bool PebbleLog::backendParked = false;
+    inline std::atomic<BackendMode> PebbleLog::backendMode{BackendMode::ASYNC};
+    inline std::mutex PebbleLog::writerMutex;
+    inline std::mutex PebbleLog::modeMutex;
+    inline PebbleLog::InlineSchedule PebbleLog::inlineSchedule;
+    inline std::atomic<bool> PebbleLog::hasQueuedRecords{false};
+    inline std::atomic<WaitStrategy> PebbleLog::waitStrategy{WaitStrategy::BLOCKING};
+    inline std::atomic<int64_t> PebbleLog::sleepIntervalUs{100};
+    inline std::mutex PebbleLog::placementMutex;
+    inline ThreadPlacement PebbleLog::backendPlacement;
+    inline std::atomic<uint64_t> PebbleLog::backendPlacementVersion{0};
+    inline BacktraceRing PebbleLog::backtrace;
+    inline CallSiteRegistry PebbleLog::callSites;
+    inline PendingRecordRing PebbleLog::pendingRecords;
+    inline char PebbleLog::crashLogPath[4096] = {};
+    inline FlushPolicy PebbleLog::flushPolicy;
+    inline LoadSheddingPolicy PebbleLog::loadSheddingPolicy;
+    inline LoadShedder PebbleLog::loadShedder;
+    inline std::chrono::milliseconds PebbleLog::metricsLogInterval{0};
+    inline MetricsCollector PebbleLog::metrics;
+    inline RecordBufferPool PebbleLog::recordPool;
+    inline TimestampClock PebbleLog::clock;
+    inline std::atomic<uint32_t> PebbleLog::formatVersion{1};
+    inline std::unique_ptr<MemorySink> PebbleLog::memorySinkOwner;
+    inline std::atomic<MemorySink *> PebbleLog::memorySink{nullptr};
+    inline std::unique_ptr<SocketSink> PebbleLog::socketSinkOwner;
+    inline std::atomic<SocketSink *> PebbleLog::socketSink{nullptr};
+    inline std::vector<std::unique_ptr<SharedRing>> PebbleLog::sharedRings;
+    inline std::atomic<SharedRing *> PebbleLog::sharedRing{nullptr};
+    inline std::unique_ptr<SharedRingCollector> PebbleLog::ringCollector;
+    inline std::atomic<uint64_t> PebbleLog::pathVersion{1};
+#ifndef _WIN32
+    inline std::vector<iovec> PebbleLog::consoleIov;
+    inline std::string PebbleLog::consoleCarry;
+#endif
+    inline size_t PebbleLog::consoleBytes = 0;
+    inline std::atomic<int> PebbleLog::consoleFd{io::stdoutFd};
+    inline std::atomic<DirectFileWriter *> PebbleLog::crashDirect{nullptr};
+    inline std::atomic<bool> PebbleLog::consoleColors{io::isTerminal(io::stdoutFd)};
+    inline PebbleLog::LogFile PebbleLog::logFile;
+    inline std::vector<DurableAck::State *> PebbleLog::durableRequests;
+    inline bool PebbleLog::durableSyncFailed = false;
+    static bool skipDebug = false;
+
+    //  PebbleLog 캯гʼ̨ģʽ
+    // ̨̺̳߳߳ضڵһʹʱֻòĽ̲ᴴκ߳
+    inline PebbleLog::PebbleLog() : stopFlag(false), threadPool(std::min<size_t>(std::thread::hardware_concurrency(), kDefaultPoolSize)) {
+#ifdef _WIN32
+        // ն֧
+        HANDLE hOut = GetStdHandle(STD_OUTPUT_HANDLE);
+        DWORD dwMode = 0;
+        if (GetConsoleMode(hOut, &dwMode)) {
+            dwMode |= ENABLE_VIRTUAL_TERMINAL_PROCESSING;
+            SetConsoleMode(hOut, dwMode);
+        }
+#endif
+#ifndef _WIN32
+        creatorPid = static_cast<int64_t>(::getpid());
+#endif
+    }
+
+    inline PebbleLog::Owner::~Owner() {
+#ifndef _WIN32
+        // fork ӽ̣ӹḶ́˳ʱ̶̳߳ûжӦ̣߳ȲܵȴҲܷ
+        if (static_cast<int64_t>(::getpid()) != instance->creatorPid) {
+            stopSharedRingCollector();
+            (void) configWatcher.release();
+            return;
+        }
+#endif
+        delete instance;
+    }
+
+    inline PebbleLog::~PebbleLog() {
+        stopSharedRingCollector();// Ȱѹʣļ¼ת
+        {
+            // ãں̨̼֮߳󡢿ʼȴ֮ǰ֪ͨʧjoin ᷵
+            std::lock_guard<std::mutex> lock(queueMutex);
+            stopFlag = true;
+            queueCond.notify_all();
+        }
+        if (logThread.joinable()) {
+            logThread.join();
+        } else {
+            // ͬģʽδ̨̣߳дݲرļ
+            std::lock_guard<std::mutex> lock(writerMutex);
+            flushSinks();
+            closeLogFile();
+        }
+    }
+
+    inline void PebbleLog::processLogs() {
+        using Clock = std::chrono::steady_clock;
+        std::vector<LogRecord> batch;
+        FlushPolicy policy;
+        std::chrono::milliseconds metricsInterval;
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            policy = flushPolicy;
+            metricsInterval = metricsLogInterval;
+        }
+        auto nextFlush = Clock::now() + policy.interval;
+        auto nextMetricsLog = Clock::now() + metricsInterval;
+        auto nextCalibration = Clock::now() + TimestampClock::kRecalibrateInterval;
+        uint64_t appliedPlacement = 0;
+        LoadSheddingPolicy shedPolicy;
+        while (true) {
+            if (backendPlacementVersion.load(std::memory_order_acquire) != appliedPlacement) {
+                std::lock_guard<std::mutex> lock(placementMutex);
+                applyThreadPlacement(backendPlacement);
+                appliedPlacement = backendPlacementVersion.load(std::memory_order_relaxed);
+            }
+            {
+                auto deadline = Clock::time_point::max();
+                if (policy.interval.count() > 0) deadline = nextFlush;
+                if (metricsInterval.count() > 0) deadline = std::min(deadline, nextMetricsLog);
+                // ڼ伴ʹû¼¼ҲҪʱָܷ
+                if (loadShedder.active()) deadline = std::min(deadline, Clock::now() + shedPolicy.holdTime);
+                if (waitStrategy.load(std::memory_order_relaxed) != WaitStrategy::BLOCKING) {
+                    pollForRecords(deadline, appliedPlacement);
+                }
+
+                std::unique_lock<std::mutex> lock(queueMutex);
+                auto ready = [this, appliedPlacement] {
+                    return !logQueue.empty() || stopFlag.load() ||
+                           waitStrategy.load(std::memory_order_relaxed) != WaitStrategy::BLOCKING ||
+                           backendPlacementVersion.load(std::memory_order_relaxed) != appliedPlacement;
+                };
+                // ֻȷʵڵȴʱҪ߻
+                backendParked = true;
+                if (deadline != Clock::time_point::max()) {
+                    queueCond.wait_until(lock, deadline, ready);
+                } else {
+                    queueCond.wait(lock, ready);
+                }
+                backendParked = false;
+                // лͬģʽʱȶſգлǰԻӣʣ¼ setBackendMode д
+                if (stopFlag.load() && (logQueue.empty() || detachBackend)) break;
+                batch.swap(logQueue);// ȡټ
+                hasQueuedRecords.store(false, std::memory_order_relaxed);
+                shedPolicy = loadSheddingPolicy;
+                policy = flushPolicy;
+                metricsInterval = metricsLogInterval;
+            }
+
+            size_t backlog = countRecords(batch);
+            metrics.recordDequeued(backlog);
+            if (auto episode = loadShedder.update(shedPolicy, backlog, Clock::now(), metrics)) {
+                log(LogLevel::WARN, episode->toString());
+            }
+            {
+                ConfigStore::Reader config = configStore.read();// ڼǼΪߣڲٴζȡظǼ
+                writeBatch(batch, policy);
+            }
+            configStore.reclaim();
+
+            if (Clock::now() >= nextCalibration) {
+                clock.recalibrate();
+                nextCalibration = Clock::now() + TimestampClock::kRecalibrateInterval;
+            }
+
+            if (policy.interval.count() > 0 && Clock::now() >= nextFlush) {
+                flushSinks();
+                nextFlush = Clock::now() + policy.interval;
+            } else if (policy.onIdle) {
+                std::lock_guard<std::mutex> lock(queueMutex);
+                if (logQueue.empty()) flushSinks();
+            }
+
+            if (metricsInterval.count() > 0 && Clock::now() >= nextMetricsLog) {
+                log(LogLevel::INFO, getMetrics().toString());
+                nextMetricsLog = Clock::now() + metricsInterval;
+            }
+        }
+
+        // ˳ǰдʣ
+        flushSinks();
+        closeLogFile();
+    }
+
+    // flush() ûмʱҲܼ
+    inline size_t PebbleLog::countRecords(const std::vector<LogRecord> &batch) {
+        return static_cast<size_t>(std::count_if(batch.begin(), batch.end(), [](const LogRecord &record) { return !record.flushRequest; }));
+    }
+
+    //  flush() ϰгɶд֮ǰдٻѵȴ
+    inline void PebbleLog::writeBatch(std::vector<LogRecord> &batch, const FlushPolicy &policy) {
+        formatPrefixes(batch);
+        size_t begin = 0;
+        for (size_t i = 0; i <= batch.size(); ++i) {
+            if (i < batch.size() && !batch[i].flushRequest) continue;
+            writeSegment(batch, begin, i, policy);
+            if (i < batch.size()) {
+                flushSinks();
+                batch[i].flushRequest->set_value();
+            }
+            begin = i + 1;
+        }
+        if (!durableRequests.empty()) commitDurable();
+        // ֶ̨еϢǰ׺ͷǰдڿʱˢµĲ¸Ʊ level/bytes/interval ʱд
+        if (policy.onIdle) {
+            flushConsole();
+        } else {
+            retainConsole();
+        }
+        for (LogRecord &record: batch) {
+            if (!record.overflow.empty()) recordPool.release(std::move(record.overflow));
+        }
+        batch.clear();
+    }
+
+    // ȴԣѯӱ־ֱ¼¼ deadlineյֹͣźŻñ仯
+    inline void PebbleLog::pollForRecords(std::chrono::steady_clock::time_point deadline, uint64_t appliedPlacement) {
+        using Clock = std::chrono::steady_clock;
+        bool timed = deadline != Clock::time_point::max();
+        for (uint32_t spins = 0;; ++spins) {
+            if (hasQueuedRecords.load(std::memory_order_acquire) || stopFlag.load(std::memory_order_relaxed)) return;
+            if (backendPlacementVersion.load(std::memory_order_relaxed) != appliedPlacement) return;
+            if (timed && Clock::now() >= deadline) return;
+            switch (waitStrategy.load(std::memory_order_relaxed)) {
+                case WaitStrategy::BUSY_SPIN:
+                    cpuRelax();
+                    break;
+                case WaitStrategy::SPIN_YIELD:
+                    if (spins < kSpinCount) {
+                        cpuRelax();
+                    } else {
+                        std::this_thread::yield();
+                    }
+                    break;
+                case WaitStrategy::SLEEP:
+                    std::this_thread::sleep_for(std::chrono::microseconds(sleepIntervalUs.load(std::memory_order_relaxed)));
+                    break;
+                default:
+                    return;// л BLOCKING
+            }
+        }
+    }
+
+    // ¼Ӻã÷ queueMutexһʱ̨̨̣߳߳ûϵȴʱʡȥ notify
+    inline void PebbleLog::wakeBackendLocked() {
+        PebbleLog &instance = getInstance();
+        if (!instance.backendStarted) instance.startBackendLocked();
+        hasQueuedRecords.store(true, std::memory_order_release);
+        if (backendParked) queueCond.notify_one();
+    }
+
+    inline void PebbleLog::startBackendLocked() {
+        logThread = std::thread(&PebbleLog::processLogs, this);
+        backendStarted = true;
+    }
+
+    // 첽ģʽУͬģʽڵǰ߳дģʽڸԵȷһΣлύļ¼֮
+    inline void PebbleLog::submit(std::vector<LogRecord> &records) {
+        while (!records.empty()) {
+            if (backendMode.load(std::memory_order_acquire) == BackendMode::SYNC) {
+                if (writeInline(records)) return;
+                continue;
+            }
+            std::lock_guard<std::mutex> lock(getInstance().queueMutex);
+            if (backendMode.load(std::memory_order_relaxed) != BackendMode::ASYNC) continue;
+            for (auto &record: records) {
+                logQueue.push_back(std::move(record));
+            }
+            wakeBackendLocked();
+            records.clear();
+        }
+    }
+
+    // л첽ģʽʱ falseɵ÷Ϊ
+    inline bool PebbleLog::writeInline(std::vector<LogRecord> &records) {
+        InlineWriter &writer = inlineWriter();
+        if (writer.writing) {
+            for (auto &record: records) {
+                writer.nested.push_back(std::move(record));
+            }
+            records.clear();
+            return true;
+        }
+        bool logMetrics = false;
+        {
+            std::lock_guard<std::mutex> lock(writerMutex);
+            if (backendMode.load(std::memory_order_relaxed) != BackendMode::SYNC) return false;
+            getInstance().writeInlineLocked(records);
+            auto now = std::chrono::steady_clock::now();
+            if (metricsLogInterval.count() > 0 && now >= inlineSchedule.nextMetricsLog) {
+                logMetrics = true;
+                inlineSchedule.nextMetricsLog = now + metricsLogInterval;
+            }
+        }
+        if (logMetrics) log(LogLevel::INFO, getMetrics().toString());
+        return true;
+    }
+
+    // ÷ writerMutexÿεö൱ڴУˢ²ԾǷд
+    inline void PebbleLog::writeInlineLocked(std::vector<LogRecord> &records) {
+        using Clock = std::chrono::steady_clock;
+        InlineWriter &writer = inlineWriter();
+        writer.writing = true;
+        while (!records.empty()) {
+            metrics.recordDequeued(countRecords(records));
+            {
+                ConfigStore::Reader config = configStore.read();
+                writeBatch(records, flushPolicy);
+            }
+            records.swap(writer.nested);
+        }
+        writer.writing = false;
+        configStore.reclaim();
+
+        auto now = Clock::now();
+        if (now >= inlineSchedule.nextCalibration) {
+            clock.recalibrate();
+            inlineSchedule.nextCalibration = now + TimestampClock::kRecalibrateInterval;
+        }
+        if (flushPolicy.onIdle || (flushPolicy.interval.count() > 0 && now >= inlineSchedule.nextFlush)) {
+            flushSinks();
+            inlineSchedule.nextFlush = now + flushPolicy.interval;
+        }
+    }
+
+    inline PebbleLog::InlineWriter &PebbleLog::inlineWriter() {
+        static thread_local InlineWriter writer;
+        return writer;
+    }
+
+    inline bool applyThreadPlacement(const ThreadPlacement &placement) {
+        bool ok = true;
+#if defined(__linux__)
+        if (!placement.cpus.empty()) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            for (int cpu: placement.cpus) {
+                if (cpu >= 0 && cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+            }
+            ok = pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0 && ok;
+        }
+        if (!placement.name.empty()) {
+            char name[16] = {};
+            std::strncpy(name, placement.name.c_str(), sizeof(name) - 1);
+            ok = pthread_setname_np(pthread_self(), name) == 0 && ok;
+        }
+        if (placement.niceValue) {
+            // Linux  nice ֵ߳Ч
+            ok = setpriority(PRIO_PROCESS, static_cast<id_t>(::syscall(SYS_gettid)), *placement.niceValue) == 0 && ok;
+        }
+#elif defined(_WIN32)
+        if (!placement.cpus.empty()) {
+            DWORD_PTR mask = 0;
+            for (int cpu: placement.cpus) {
+                if (cpu >= 0 && cpu < static_cast<int>(sizeof(DWORD_PTR) * 8)) mask |= DWORD_PTR(1) << cpu;
+            }
+            ok = SetThreadAffinityMask(GetCurrentThread(), mask) != 0 && ok;
+        }
+        if (!placement.name.empty()) {
+            std::wstring name(placement.name.begin(), placement.name.end());
+            ok = SUCCEEDED(SetThreadDescription(GetCurrentThread(), name.c_str())) && ok;
+        }
+        if (placement.niceValue) {
+            int priority = *placement.niceValue > 0 ? THREAD_PRIORITY_BELOW_NORMAL : *placement.niceValue < 0 ? THREAD_PRIORITY_ABOVE_NORMAL : THREAD_PRIORITY_NORMAL;
+            ok = SetThreadPriority(GetCurrentThread(), priority) != 0 && ok;
+        }
+#else
+        // ƽֻ̨֧߳
+        if (!placement.name.empty()) {
+#ifdef __APPLE__
+            ok = pthread_setname_np(placement.name.c_str()) == 0 && ok;
+#endif
+        }
+        if (!placement.cpus.empty() || placement.niceValue) ok = false;
+#endif
+        if (!ok) std::cerr << "Failed to apply thread placement for " << (placement.name.empty() ? "log thread" : placement.name) << std::endl;
+        return ok;
+    }
+
+    inline void PebbleLog::cpuRelax() {
+#if defined(PEBBLELOG_HAS_RDTSC)
+        _mm_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield");
+#endif
+    }
+
+    // ʱʽ¼ǰ׺ͺ׺֮ prefixArena ֶ̨οֱ
+    inline void PebbleLog::formatPrefixes(std::vector<LogRecord> &batch) {
+        prefixArena.clear();
+        TimestampClock::Calibration calibration = clock.calibration();
+        PatternFormatter &pattern = prepareFormatter(formatter);
+        bool hasSuffix = pattern.hasSuffix();
+        escape::Mode escaping = pattern.escaping();
+        for (LogRecord &record: batch) {
+            if (record.flushRequest) continue;
+            if (escaping != escape::Mode::NONE) escapeMessage(record, escaping);
+            PatternFormatter::Context context{record.level, record.threadId, calibration.toWallNanos(record.stamp()), record.site};
+            record.timestamp = static_cast<uint64_t>(context.wallNanos);
+            record.clockKind = TimestampClock::REALTIME;
+            size_t offset = prefixArena.size();
+            pattern.appendPrefix(context, prefixArena);
+            // ʽкܳıֶܳΣض϶óȻ
+            prefixArena.resize(std::min(prefixArena.size(), offset + LogRecord::kMaxAffixLength));
+            record.prefixOffset = static_cast<uint32_t>(offset);
+            record.prefixLength = static_cast<uint16_t>(prefixArena.size() - offset);
+            if (hasSuffix) {
+                size_t suffixOffset = prefixArena.size();
+                pattern.appendSuffix(context, prefixArena);
+                prefixArena.resize(std::min(prefixArena.size(), suffixOffset + LogRecord::kMaxAffixLength));
+                record.suffixLength = static_cast<uint16_t>(prefixArena.size() - suffixOffset);
+            }
+        }
+    }
+
+    // ϢҪת壬ֻҵҪתֽʱŰתдеĻ壬滻ԭ
+    inline void PebbleLog::escapeMessage(LogRecord &record, escape::Mode mode) {
+        std::string_view text = record.text();
+        size_t clean = escape::find(text, mode);
+        if (clean == text.size()) return;
+        std::string escaped = recordPool.acquire(text.size() + text.size() / 2);
+        escaped.assign(text.data(), clean);
+        escape::append(text.substr(clean), mode, escaped);
+        if (!record.overflow.empty()) recordPool.release(std::move(record.overflow));
+        record.overflow = std::move(escaped);
+        record.length = static_cast<uint32_t>(record.overflow.size());
+    }
+
+    inline void PebbleLog::writeSegment(std::vector<LogRecord> &batch, size_t begin, size_t end, const FlushPolicy &policy) {
+        if (begin >= end) return;
+        for (size_t i = begin; i < end; ++i) {
+            LogRecord &entry = batch[i];
+            if (entry.durableRequest) durableRequests.push_back(std::exchange(entry.durableRequest, nullptr));
+            if (!pendingRecords.beginWrite(entry.crashTicket)) {
+                entry.length = 0;// ɱ·д
+                continue;
+            }
+            if (entry.crashTicket) unflushedTickets.push_back(entry.crashTicket);
+            metrics.recordWritten(entry.level);
+        }
+
+        LogType type = configStore.read()->type;
+        bool toConsole = type == LogType::CONSOLE || type == LogType::BOTH;
+        bool toFile = type == LogType::FILE || type == LogType::BOTH;
+        auto writeConsole = [this, &batch, begin, end, &policy] {
+            for (size_t i = begin; i < end; ++i) {
+                if (batch[i].length) writeLogToConsole(batch[i].level, batch[i].prefix(prefixArena), batch[i].text(), batch[i].suffix(prefixArena));
+                if (shouldFlush(policy, batch[i].level, consoleBytes)) flushConsole();
+            }
+        };
+
+        // ͬʱʱ̨̳߳أļں̨߳дԱּ¼˳ͬģʽʹ̳߳
+        std::atomic<bool> consoleDone{true};
+        if (toConsole && toFile && backendMode.load(std::memory_order_relaxed) == BackendMode::ASYNC) {
+            consoleDone.store(false, std::memory_order_relaxed);
+            threadPool.post([&writeConsole, &consoleDone] {
+                writeConsole();
+                consoleDone.store(true, std::memory_order_release);
+                consoleDone.notify_one();
+            });
+        } else if (toConsole) {
+            writeConsole();
+        }
+        if (toFile) {
+            for (size_t i = begin; i < end; ++i) {
+                if (batch[i].length) writeLogToFile(batch[i], batch[i].prefix(prefixArena), batch[i].text(), batch[i].suffix(prefixArena));
+                if (shouldFlush(policy, batch[i].level, logFile.unflushed())) flushFile();
+            }
+        }
+        if (MemorySink *sink = memorySink.load(std::memory_order_acquire)) {
+            for (size_t i = begin; i < end; ++i) {
+                if (batch[i].length) sink->write(batch[i].level, batch[i].prefix(prefixArena), batch[i].text(), batch[i].suffix(prefixArena));
+            }
+        }
+#ifndef _WIN32
+        if (SocketSink *sink = socketSink.load(std::memory_order_acquire)) {
+            for (size_t i = begin; i < end; ++i) {
+                if (batch[i].length) {
+                    sink->write(batch[i].level, static_cast<int64_t>(batch[i].timestamp), batch[i].prefix(prefixArena), batch[i].text(),
+                                batch[i].suffix(prefixArena));
+                }
+            }
+            if (uint64_t dropped = sink->submit()) metrics.recordDropped(dropped);
+        }
+#endif
+        consoleDone.wait(false, std::memory_order_acquire);
+
+        if (consoleBytes == 0 && logFile.unflushed() == 0) {
+            for (uint64_t ticket: unflushedTickets) pendingRecords.endWrite(ticket);
+            unflushedTickets.clear();
+        }
+    }
+
+    inline bool PebbleLog::shouldFlush(const FlushPolicy &policy, LogLevel level, size_t pendingBytes) {
+        if (pendingBytes == 0) return false;
+        // TRACE ö󣬵
+        if (policy.level && level != LogLevel::TRACE && level >= *policy.level) return true;
+        return policy.bytes > 0 && pendingBytes >= policy.bytes;
+    }
+
+    // ύĳ־ûһ fdatasyncԽ࣬ÿ̯ͬԽС
+    inline void PebbleLog::commitDurable() {
+        LogType type = configStore.read()->type;
+        bool toFile = type == LogType::FILE || type == LogType::BOTH;
+        flushFile();
+        // дʧʱݲļУfdatasync ɹҲȷ
+        bool ok = toFile && logFile.fd >= 0 && !durableSyncFailed && io::syncData(logFile.fd);
+        if (ok) metrics.recordSync();
+        for (DurableAck::State *state: durableRequests) {
+            if (std::coroutine_handle<> handle = state->complete(ok)) {
+                if (threadPool.size() > 0) {
+                    threadPool.post([handle] { handle.resume(); });
+                } else {
+                    continuations.post(handle);
+                }
+            }
+            state->release();
+        }
+        durableRequests.clear();
+        durableSyncFailed = false;
+    }
+
+    inline void PebbleLog::flushSinks() {
+        flushConsole();
+        flushFile();
+        for (uint64_t ticket: unflushedTickets) pendingRecords.endWrite(ticket);
+        unflushedTickets.clear();
+    }
+
+    inline void PebbleLog::setMetricsLogInterval(std::chrono::milliseconds interval) {
+        std::scoped_lock lock(getInstance().queueMutex, writerMutex);// ͬ setFlushPolicy
+        metricsLogInterval = interval;
+        getInstance().queueCond.notify_one();
+    }
+
+    inline LogMetrics PebbleLog::getMetrics() {
+        LogMetrics snapshot = metrics.snapshot();
+        snapshot.bufferAllocations = recordPool.allocationCount();
+        return snapshot;
+    }
+
+    inline MemorySink &PebbleLog::enableMemorySink(size_t capacity) {
+        std::lock_guard<std::mutex> lock(logMutex);
+        if (!memorySinkOwner) memorySinkOwner = std::make_unique<MemorySink>(capacity);
+        memorySink.store(memorySinkOwner.get(), std::memory_order_release);
+        return *memorySinkOwner;
+    }
+
+    // ʵ˳еĶԿɶȡʣ¼
+    inline void PebbleLog::disableMemorySink() { memorySink.store(nullptr, std::memory_order_release); }
+
+    inline MemorySink *PebbleLog::getMemorySink() {
+        std::lock_guard<std::mutex> lock(logMutex);
+        return memorySinkOwner.get();
+    }
+
+#ifndef _WIN32
+    inline bool PebbleLog::enableSocketSink(const SocketSinkOptions &options) {
+        if (options.path.empty() || options.path.size() >= sizeof(sockaddr_un::sun_path)) {
+            std::cerr << "Invalid socket path: " << options.path << std::endl;
+            return false;
+        }
+        disableSocketSink();
+        std::lock_guard<std::mutex> lock(logMutex);
+        socketSinkOwner = std::make_unique<SocketSink>(options);
+        socketSink.store(socketSinkOwner.get(), std::memory_order_release);
+        return true;
+    }
+
+    // flush() ʱ̨߳Ѳʹþɵ֮ʱʣ¼
+    // 첽ģʽº̨̻߳ûʱûʹþɵύϣֻ̨߳
+    inline void PebbleLog::disableSocketSink() {
+        socketSink.store(nullptr, std::memory_order_release);
+        bool idle = false;
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            idle = !getInstance().backendStarted && backendMode.load(std::memory_order_relaxed) == BackendMode::ASYNC;
+        }
+        if (!idle) flush();
+        std::unique_ptr<SocketSink> previous;
+        {
+            std::lock_guard<std::mutex> lock(logMutex);
+            previous = std::move(socketSinkOwner);
+        }
+    }
+
+    inline SocketSinkStats PebbleLog::getSocketSinkStats() {
+        std::lock_guard<std::mutex> lock(logMutex);
+        return socketSinkOwner ? socketSinkOwner->getStats() : SocketSinkStats{};
+    }
+#else
+    inline bool PebbleLog::enableSocketSink(const SocketSinkOptions &) { return false; }
+    inline void PebbleLog::disableSocketSink() {}
+    inline SocketSinkStats PebbleLog::getSocketSinkStats() { return {}; }
+#endif
+
+    inline DurableAck PebbleLog::vlogDurable(LogLevel level, std::string_view formatStr, std::format_args args) {
+        auto *state = new DurableAck::State;
+        DurableAck ack(state);
+        if (level < levelFilter.load(std::memory_order_acquire)) {
+            state->complete(false);
+            return ack;
+        }
+        TimestampClock::Stamp stamp = clock.now();
+        std::string &message = scratchBuffer();
+        std::vformat_to(std::back_inserter(message), formatStr, args);
+        state->retain();// еļ¼һãɺ̨ȷϺͷ
+        enqueue(level, stamp, message, state);
+        return ack;
+    }
+
+    inline void PebbleLog::flush() {
+#ifndef _WIN32
+        // ֻ߽ܵȵ¼ռȡߣ֮ռ߸д
+        if (SharedRing *ring = sharedRing.load(std::memory_order_acquire)) {
+            ring->waitCollected();
+            return;
+        }
+#endif
+        std::promise<void> done;
+        std::future<void> future = done.get_future();
+        std::vector<LogRecord> barrier(1);
+        barrier.front().flushRequest = &done;
+        submit(barrier);
+        future.wait();
+    }
+
+    // ÷
+    // Ƶǰ޸ĺ󷢲ֵĻʧЧ
+    template<typename Mutate>
+    inline void PebbleLog::updateConfig(Mutate &&mutate) {
+        bool pathChanged = false;
+        bool formatChanged = false;
+        configStore.update([&](LogConfig &config) {
+            LogConfig previous = config;
+            mutate(config);
+            pathChanged = config.logPath != previous.logPath || config.logName != previous.logName ||
+                          config.compression.codec != previous.compression.codec || config.fileIo.directIo != previous.fileIo.directIo ||
+                          config.fileIo.preallocate != previous.fileIo.preallocate;
+            formatChanged = config.timeFormat != previous.timeFormat || config.prefixFormat != previous.prefixFormat ||
+                            config.pattern != previous.pattern || config.outputFormat != previous.outputFormat;
+            levelFilter.store(config.level, std::memory_order_release);// õдڸ£뷢˳һ
+        });
+        if (pathChanged) pathVersion.fetch_add(1, std::memory_order_release);
+        if (formatChanged) formatVersion.fetch_add(1, std::memory_order_release);
+        updateCrashLogPath();
+    }
+
+    inline void PebbleLog::setLogLevel(LogLevel level) {
+        updateConfig([level](LogConfig &config) { config.level = level; });
+    }
+    inline void PebbleLog::setLogType(LogType type) {
+        updateConfig([type](LogConfig &config) { config.type = type; });
+    }
+    inline void PebbleLog::setMaxFileSize(size_t size) {
+        updateConfig([size](LogConfig &config) { config.maxFileSize = size; });
+    }
+    inline void PebbleLog::setMaxFileCount(size_t count) {
+        updateConfig([count](LogConfig &config) { config.maxFileCount = count; });
+    }
+    inline void PebbleLog::setLogPath(const std::string &path) {
+        updateConfig([&path](LogConfig &config) { config.logPath = path; });
+    }
+    inline void PebbleLog::setLogName(const std::string &name) {
+        updateConfig([&name](LogConfig &config) { config.logName = name; });
+    }
+
+    inline void PebbleLog::setTimeFormat(const std::string &format) {
+        updateConfig([&format](LogConfig &config) { config.timeFormat = format; });
+    }
+
+    inline void PebbleLog::setConsolePrefixFormat(const std::string &format) { setFilePrefixFormat(format); }
+
+    inline void PebbleLog::setFilePrefixFormat(const std::string &format) {
+        updateConfig([&format](LogConfig &config) { config.prefixFormat = format; });
+    }
+
+    inline void PebbleLog::setPattern(const std::string &pattern) {
+        updateConfig([&pattern](LogConfig &config) { config.pattern = pattern; });
+    }
+
+    inline void PebbleLog::setOutputFormat(OutputFormat format) {
+        updateConfig([format](LogConfig &config) { config.outputFormat = format; });
+    }
+
+    inline void PebbleLog::setFileIndex(const FileIndexPolicy &policy) {
+        updateConfig([&policy](LogConfig &config) { config.fileIndex = policy; });
+    }
+
+    inline void PebbleLog::setFileCompression(const FileCompressionPolicy &policy) {
+        updateConfig([&policy](LogConfig &config) { config.compression = policy; });
+    }
+
+    inline void PebbleLog::setFileIo(const FileIoPolicy &policy) {
+        updateConfig([&policy](LogConfig &config) { config.fileIo = policy; });
+    }
+
+    inline LogConfig PebbleLog::getConfig() { return *configStore.read(); }
+
+    inline void PebbleLog::setConfig(const LogConfig &newConfig) {
+        updateConfig([&newConfig](LogConfig &config) { config = newConfig; });
+    }
+
+    // ļûгֵֵǰֵ"#" ͷΪע
+    inline bool PebbleLog::loadConfigFile(const std::string &path) {
+        std::ifstream in(path);
+        if (!in) {
+            std::cerr << "Failed to open config file: " << path << std::endl;
+            return false;
+        }
+        LogConfig next = getConfig();
+        bool ok = true;
+        std::string line;
+        for (size_t lineNumber = 1; std::getline(in, line); ++lineNumber) {
+            std::string_view text = configfile::trim(line);
+            if (text.empty() || text.front() == '#') continue;
+            size_t equals = text.find('=');
+            if (equals == std::string_view::npos ||
+                !configfile::apply(next, configfile::trim(text.substr(0, equals)), configfile::trim(text.substr(equals + 1)))) {
+                std::cerr << "Invalid config entry at " << path << ":" << lineNumber << ": " << text << std::endl;
+                ok = false;
+            }
+        }
+        if (ok) setConfig(next);
+        return ok;
+    }
+
+    inline bool PebbleLog::watchConfigFile(const std::string &path) {
+        bool loaded = loadConfigFile(path);
+        auto watcher = std::make_unique<ConfigFileWatcher>(path, [path] { loadConfigFile(path); });
+        std::unique_ptr<ConfigFileWatcher> previous;
+        {
+            std::lock_guard<std::mutex> lock(logMutex);
+            previous = std::exchange(configWatcher, std::move(watcher));
+        }
+        return loaded;// previous ȴɵļ߳˳
+    }
+
+    inline void PebbleLog::unwatchConfigFile() {
+        std::unique_ptr<ConfigFileWatcher> previous;
+        {
+            std::lock_guard<std::mutex> lock(logMutex);
+            previous = std::move(configWatcher);
+        }
+    }
+
+#ifndef _WIN32
+    inline bool PebbleLog::startSharedRingCollector(const std::string &name, size_t slotCount) {
+        getInstance();// ռļ¼ɺ̨߳д
+        std::unique_ptr<SharedRing> ring = SharedRing::create(name, slotCount);
+        if (!ring) {
+            std::cerr << "Failed to create shared ring: " << name << std::endl;
+            return false;
+        }
+        auto collector = std::make_unique<SharedRingCollector>(std::move(ring), &PebbleLog::collectSharedRing);
+        std::unique_ptr<SharedRingCollector> previous;
+        {
+            std::lock_guard<std::mutex> lock(logMutex);
+            previous = std::exchange(ringCollector, std::move(collector));
+        }
+        return true;// previous ȴɵռ߳ȡʣ¼
+    }
+
+    inline void PebbleLog::stopSharedRingCollector() {
+        std::unique_ptr<SharedRingCollector> previous;
+        {
+            std::lock_guard<std::mutex> lock(logMutex);
+            previous = std::move(ringCollector);
+        }
+    }
+
+    inline bool PebbleLog::attachSharedRing(const std::string &name) {
+        std::unique_ptr<SharedRing> ring = SharedRing::attach(name);
+        if (!ring) {
+            std::cerr << "Failed to attach shared ring: " << name << std::endl;
+            return false;
         }
-    };
+        std::lock_guard<std::mutex> lock(logMutex);
+        sharedRing.store(ring.get(), std::memory_order_release);
+        sharedRings.push_back(std::move(ring));
+        return true;
+    }
 
-    class TraceMiddleware : public LoggerMiddleware<TraceMiddleware> {
-    public:
-        TraceMiddleware(const std::string &file, int line, const std::string &func, const std::string &args)
-            : file(file), line(line), func(func), args(args) {}
+    // Ӻļ¼ص̵ĶУӳ䲻д̲߳Ӱ
+    inline void PebbleLog::detachSharedRing() { sharedRing.store(nullptr, std::memory_order_release); }
 
-        void process() {
-            std::lock_guard<std::mutex> lock(PebbleLog::getMutex());
-            std::stringstream ss;
-            ss << "[Trace] File: " << file << ", Line: " << line << ", Function: " << func << ", Args: " << args;
-            PebbleLog::info(ss.str());// ʹ־
+    // ռ̣߳ȡеļ¼һμתУֹͣʱȡ껷ʣļ¼
+    inline void PebbleLog::collectSharedRing(SharedRing &ring, const std::atomic<bool> &stopping) {
+        std::vector<LogRecord> batch;
+        std::string message;
+        SharedRing::Entry entry{};
+        int idleRounds = 0;
+        while (true) {
+            while (batch.size() < kCollectBatch && ring.pop(entry, message)) {
+                LogRecord &record = batch.emplace_back();
+                record.level = entry.level;
+                record.timestamp = static_cast<uint64_t>(entry.wallNanos);// ѻΪǽʱ
+                record.clockKind = TimestampClock::REALTIME;
+                record.threadId = entry.threadId;
+                record.assign(message, spillFor(message));
+                metrics.recordEnqueue(entry.level);
+            }
+            if (uint64_t dropped = ring.takeDropped()) {// ռ߲ʱĶ޷㱨ֻǱļ¼
+                log(LogLevel::WARN, std::format("Shared ring: dropped {} records from exited producers", dropped));
+            }
+            if (!batch.empty()) {
+                submit(batch);
+                idleRounds = 0;
+                continue;
+            }
+            if (stopping.load(std::memory_order_acquire)) return;
+            if (++idleRounds < kCollectSpins) {
+                cpuRelax();
+                continue;
+            }
+            ring.wait(kCollectWait);
+            if (!ring.ready()) ring.skipAbandoned();
         }
+    }
+#else
+    inline bool PebbleLog::startSharedRingCollector(const std::string &, size_t) { return false; }
+    inline void PebbleLog::stopSharedRingCollector() {}
+    inline bool PebbleLog::attachSharedRing(const std::string &) { return false; }
+    inline void PebbleLog::detachSharedRing() {}
+#endif
 
-    private:
-        std::string file;
-        int line;
-        std::string func;
-        std::string args;
-    };
+    inline void PebbleLog::setConsoleTarget(ConsoleTarget target) {
+        int fd = target == ConsoleTarget::STDERR ? io::stderrFd : io::stdoutFd;
+        consoleColors.store(io::isTerminal(fd), std::memory_order_relaxed);
+        consoleFd.store(fd, std::memory_order_relaxed);
+    }
 
-    class ThreadIDMiddleware : public LoggerMiddleware<ThreadIDMiddleware> {
-    public:
-        ThreadIDMiddleware() {}
+    inline void PebbleLog::setTimestampSource(TimestampSource source) { clock.select(source); }
 
-        void process() {
-            std::lock_guard<std::mutex> lock(PebbleLog::getMutex());
-            std::stringstream ss;
-            ss << "[ThreadID:" << std::this_thread::get_id() << "] ";
-            PebbleLog::setConsolePrefixFormat(ss.str() + PebbleLog::getConsolePrefixFormat());
+    inline void PebbleLog::setWaitStrategy(WaitStrategy strategy, std::chrono::microseconds sleepInterval) {
+        std::lock_guard<std::mutex> lock(getInstance().queueMutex);
+        sleepIntervalUs.store(std::max<int64_t>(sleepInterval.count(), 1), std::memory_order_relaxed);
+        waitStrategy.store(strategy, std::memory_order_relaxed);
+        queueCond.notify_one();//  BLOCKING лȥʱڵȴĺ̨߳
+    }
+
+    inline void PebbleLog::setBackendThreadPlacement(const ThreadPlacement &placement) {
+        getInstance();
+        {
+            std::lock_guard<std::mutex> lock(placementMutex);
+            backendPlacement = placement;
+            backendPlacementVersion.fetch_add(1, std::memory_order_release);
         }
-    };
+        std::lock_guard<std::mutex> lock(queueMutex);
+        queueCond.notify_one();
+    }
 
-    class CustomTagMiddleware : public LoggerMiddleware<CustomTagMiddleware> {
-    public:
-        CustomTagMiddleware(const std::string &tag) : tag(tag) {}
+    inline void PebbleLog::setPoolThreadPlacement(const ThreadPlacement &placement) {
+        getInstance().threadPool.setPlacement(placement);
+    }
 
-        void process() {
-            std::lock_guard<std::mutex> lock(PebbleLog::getMutex());
-            PebbleLog::setConsolePrefixFormat("[" + tag + "] " + PebbleLog::getConsolePrefixFormat());
+    inline void PebbleLog::setBackendMode(BackendMode mode) {
+        using Clock = std::chrono::steady_clock;
+        PebbleLog &instance = getInstance();
+        std::lock_guard<std::mutex> switching(modeMutex);
+        if (backendMode.load(std::memory_order_relaxed) == mode) return;
+        if (mode == BackendMode::ASYNC) {
+            // ̨߳һ¼ʱ֮ǰдͬģʽ
+            std::scoped_lock lock(queueMutex, writerMutex);
+            instance.flushSinks();
+            backendMode.store(BackendMode::ASYNC, std::memory_order_release);
+            return;
         }
 
-    private:
-        std::string tag;
-    };
-}// namespace utils::Log::MiddleWare
+        // ̨߳дϵκ˳رļȶſգм¼ʱԶŲգ
+        // ʣļ¼лʱдд֮ǰ߳ò writerMutexͬһ̵߳ļ¼
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            instance.stopFlag = true;
+            instance.detachBackend = true;
+            queueCond.notify_all();
+        }
+        if (instance.logThread.joinable()) instance.logThread.join();
+        std::scoped_lock lock(queueMutex, writerMutex);
+        instance.stopFlag = false;
+        instance.detachBackend = false;
+        instance.backendStarted = false;
+        hasQueuedRecords.store(false, std::memory_order_relaxed);
+        auto now = Clock::now();
+        inlineSchedule = {now + flushPolicy.interval, now + metricsLogInterval, now + TimestampClock::kRecalibrateInterval};
+        backendMode.store(BackendMode::SYNC, std::memory_order_release);
+        std::vector<LogRecord> remaining;
+        remaining.swap(logQueue);
+        if (!remaining.empty()) instance.writeInlineLocked(remaining);
+    }
 
-#include <cstdio>
-#include <cstring>
-#include <ctime>
-#include <fcntl.h>//  open
-#include <filesystem>
-#include <fstream>
-#ifdef _WIN32
-#include <io.h>// for _open, _close
-#include <windows.h>
-#undef ERROR// ȡ궨
-#else
-#include <unistd.h>
-#endif
+    inline BackendMode PebbleLog::getBackendMode() { return backendMode.load(std::memory_order_acquire); }
 
-namespace utils::Log {
-    namespace defalut {
-        // ̨Ĭʱʽ
-        static std::string timeFormat = "%Y-%m-%d %H:%M:%S";
-        static std::string filePrefixFormat = "";
-    };// namespace defalut
+    inline bool PebbleLog::setThreadPoolSize(size_t threads) { return getInstance().threadPool.resize(threads); }
 
-    // ʼ̬Ա
-    inline PebbleLog::LogProperty PebbleLog::logProperty;
-    inline std::mutex PebbleLog::logMutex;
-    inline std::queue<std::pair<LogLevel, std::string>> PebbleLog::logQueue;// 徲̬Ա logQueue
-    inline std::mutex PebbleLog::queueMutex;                                // 徲̬Ա
-    inline std::condition_variable PebbleLog::queueCond;                    // 徲̬Ա
-    static bool skipDebug = false;
+    // ̨̳߳ queueMutex ƣͬģʽд߳ writerMutex ȡ޸ʱҪ
+    inline void PebbleLog::setFlushPolicy(const FlushPolicy &policy) {
+        std::scoped_lock lock(getInstance().queueMutex, writerMutex);
+        flushPolicy = policy;
+        getInstance().queueCond.notify_one();// ų̰́߳µˢ¼ȴ
+    }
 
-    //  PebbleLog 캯гʼ̨ģʽ
-    inline PebbleLog::PebbleLog() : stopFlag(false), threadPool(std::thread::hardware_concurrency()) {
-#ifdef _WIN32
-        // ն֧
-        HANDLE hOut = GetStdHandle(STD_OUTPUT_HANDLE);
-        DWORD dwMode = 0;
-        if (GetConsoleMode(hOut, &dwMode)) {
-            dwMode |= ENABLE_VIRTUAL_TERMINAL_PROCESSING;
-            SetConsoleMode(hOut, dwMode);
-        }
-#endif
-        logThread = std::thread(&PebbleLog::processLogs, this);
+    inline void PebbleLog::setLoadShedding(const LoadSheddingPolicy &policy) {
+        std::lock_guard<std::mutex> lock(getInstance().queueMutex);
+        loadSheddingPolicy = policy;
+        getInstance().queueCond.notify_one();// رʱų́߳̽ڽеĽ
     }
 
-    inline PebbleLog::~PebbleLog() {
-        stopFlag = true;
-        queueCond.notify_all();
-        if (logThread.joinable()) {
-            logThread.join();
+    inline std::string PebbleLog::getLogName() { return configStore.read()->logName; }
+
+    inline std::string PebbleLog::getConsolePrefixFormat() {
+        return configStore.read()->prefixFormat;
+    }
+
+    // ־
+    inline void PebbleLog::log(LogLevel level, std::string_view message) {
+        if (level < levelFilter.load(std::memory_order_acquire)) {
+            if (backtrace.isEnabled()) backtrace.push(level, clock.now(), currentThreadId(), message);
+            return;
         }
+        if (shedding(level)) return;
+        enqueue(level, clock.now(), message);
     }
 
-    inline void PebbleLog::processLogs() {
-        while (!stopFlag.load()) {
-            std::unique_lock<std::mutex> lock(queueMutex);
-            queueCond.wait(lock, [this] { return !logQueue.empty() || stopFlag.load(); });
-
-            while (!logQueue.empty()) {
-                auto entry = logQueue.front();
-                logQueue.pop();
-                lock.unlock();// ͷ
-
-                // 첽ύ̳߳
-                threadPool.enqueue([entry = std::move(entry)]  {
-                    if (logProperty.type == LogType::CONSOLE || logProperty.type == LogType::BOTH) {
-                        writeLogToConsole(entry.first, entry.second);
-                    }
-                    if (logProperty.type == LogType::FILE || logProperty.type == LogType::BOTH) {
-                        writeLogToFile(entry.second);
-                    }
-                });
+    inline void PebbleLog::vlog(LogLevel level, std::string_view formatStr, std::format_args args) {
+        if (level < levelFilter.load(std::memory_order_acquire)) {
+            if (backtrace.isEnabled()) backtrace.push(level, clock.now(), currentThreadId(), formatStr, args);
+            return;
+        }
+        if (shedding(level)) return;
+        // ֱӸʽ߳˽еĻ壬ʡȥ vformat мַ
+        TimestampClock::Stamp stamp = clock.now();
+        std::string &message = scratchBuffer();
+        std::vformat_to(std::back_inserter(message), formatStr, args);
+        enqueue(level, stamp, message);
+    }
 
-                lock.lock();// ¼
-            }
+    inline void PebbleLog::vlogAt(CallSite &site, std::format_args args) {
+        if (site.level < levelFilter.load(std::memory_order_acquire)) {
+            if (backtrace.isEnabled()) backtrace.push(site.level, clock.now(), currentThreadId(), site.format, args);
+            return;
         }
+        if (shedding(site.level)) return;
+        site.hits.fetch_add(1, std::memory_order_relaxed);
+        TimestampClock::Stamp stamp = clock.now();
+        std::string &message = scratchBuffer();
+        std::vformat_to(std::back_inserter(message), site.format, args);
+        enqueue(site.level, stamp, message, nullptr, &site);
     }
 
-    // ÷
-    inline void PebbleLog::setLogLevel(LogLevel level) { logProperty.level = level; }
-    inline void PebbleLog::setLogType(LogType type) { logProperty.type = type; }
-    inline void PebbleLog::setMaxFileSize(size_t size) { logProperty.maxFileSize = size; }
-    inline void PebbleLog::setMaxFileCount(size_t count) { logProperty.maxFileCount = count; }
-    inline void PebbleLog::setLogPath(const std::string &path) { logProperty.logPath = path; }
-    inline void PebbleLog::setLogName(const std::string &name) { logProperty.logName = name; }
+    inline CallSite::CallSite(const char *file, int line, const char *function, std::string_view format, LogLevel level)
+        : file(file), line(line), function(function), format(format), level(level) {
+        PebbleLog::callSites.add(*this);
+    }
 
-    inline void PebbleLog::setTimeFormat(const std::string &format) { defalut::timeFormat = format; }
+    inline std::vector<CallSiteInfo> PebbleLog::getCallSites() { return callSites.snapshot(); }
+    inline bool PebbleLog::setCallSiteEnabled(uint32_t id, bool enabled) { return callSites.setEnabled(id, enabled); }
+    inline size_t PebbleLog::setCallSiteEnabled(std::string_view location, bool enabled) { return callSites.setEnabled(location, enabled); }
+    inline void PebbleLog::resetCallSiteHits() { callSites.resetHits(); }
 
-    inline void PebbleLog::setConsolePrefixFormat(const std::string &format) { defalut::filePrefixFormat = format; }
+    // ڼڸʽ֮ǰֻ
+    inline bool PebbleLog::shedding(LogLevel level) {
+        if (!loadShedder.sheds(level)) return false;
+        metrics.recordShed(level);
+        return true;
+    }
 
-    inline void PebbleLog::setFilePrefixFormat(const std::string &format) {
-        defalut::filePrefixFormat = format;
+    // ÿ̸߳õĸʽ壬ȡʱ
+    inline std::string &PebbleLog::scratchBuffer() {
+        static thread_local std::string buffer;
+        buffer.clear();
+        return buffer;
+    }
+
+    inline uint64_t PebbleLog::currentThreadId() {
+#ifdef __linux__
+        static thread_local uint64_t id = static_cast<uint64_t>(::syscall(SYS_gettid));
+#else
+        static thread_local uint64_t id = std::hash<std::thread::id>{}(std::this_thread::get_id());
+#endif
+        return id;
     }
 
-    inline const std::string &PebbleLog::getLogName() { return logProperty.logName; }
+    // ŲϢڼǰƵеĻ
+    inline std::string PebbleLog::spillFor(std::string_view message) {
+        if (message.size() <= LogRecord::kInlineSize) return {};
+        std::string spill = recordPool.acquire(message.size());
+        spill.assign(message);
+        return spill;
+    }
 
-    inline const std::string &PebbleLog::getConsolePrefixFormat() {
-        return defalut::filePrefixFormat;
+    // ҪһУֻڿʱ߸ʽǰ׺
+    inline uint64_t PebbleLog::trackForCrash(LogLevel level, int64_t wallNanos, std::string_view message) {
+        static thread_local PatternFormatter threadFormatter;
+        static thread_local std::string line;
+        line.clear();
+        formatLogMessage({level, currentThreadId(), wallNanos}, message, line, threadFormatter);
+        return pendingRecords.track(line);
     }
 
-    // ־
-    inline void PebbleLog::log(LogLevel level, std::string_view message) {
-        if (level < logProperty.level) return;
-    
-        std::string formattedMessage;
-        formatLogMessage(level, std::string(message), formattedMessage);
-    
-        std::lock_guard<std::mutex> lock(getInstance().queueMutex);
-        // ʹ emplace  pushⲻҪĿ
-        logQueue.emplace(level, std::move(formattedMessage)); // ֱӹ pair
-        getInstance().queueCond.notify_one();
+    inline void PebbleLog::enqueue(LogLevel level, TimestampClock::Stamp stamp, std::string_view message,
+                                   DurableAck::State *durable, const CallSite *site) {
+        if ((level == LogLevel::ERROR || level == LogLevel::FATAL) && backtrace.isEnabled()) {
+            dumpBacktrace();// ģǰ
+        }
+
+#ifndef _WIN32
+        // ˹߽̣ʱﻻ㣬̵ TSC У׼ͨá
+        // ¼д빲ڴʹ̱Ҳռд˲Ҫ
+        if (SharedRing *ring = sharedRing.load(std::memory_order_acquire)) {
+            ring->push(level, clock.calibration().toWallNanos(stamp), currentThreadId(), message);
+            if (durable) {
+                durable->complete(false);// ־ûȷϲ
+                durable->release();
+            }
+            return;
+        }
+#endif
+
+        bool sampled = MetricsCollector::sampleThisCall();
+        auto start = sampled ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{};
+
+        uint64_t crashTicket = 0;
+        if (pendingRecords.isEnabled()) {
+            // Ѽ¼ļ㣬TSC ģʽ²ٶȡϵͳʱ
+            crashTicket = trackForCrash(level, clock.calibration().toWallNanos(stamp), message);
+        }
+        std::string spill = spillFor(message);
+        uint64_t threadId = currentThreadId();
+        metrics.recordEnqueue(level);// ȼ֤д
+        auto fill = [&](LogRecord &record) {
+            record.level = level;
+            record.timestamp = stamp.ticks;
+            record.clockKind = stamp.kind;
+            record.threadId = threadId;
+            record.crashTicket = crashTicket;
+            record.durableRequest = durable;
+            record.site = site;
+            record.assign(message, std::move(spill));
+        };
+        bool queued = false;
+        if (backendMode.load(std::memory_order_acquire) == BackendMode::ASYNC) {
+            std::lock_guard<std::mutex> lock(getInstance().queueMutex);
+            if (backendMode.load(std::memory_order_relaxed) == BackendMode::ASYNC) {
+                fill(logQueue.emplace_back());
+                wakeBackendLocked();
+                queued = true;
+            }
+        }
+        if (!queued) {
+            // ͬģʽ¼ڵǰ̵߳
+            InlineWriter &writer = inlineWriter();
+            fill((writer.writing ? writer.nested : writer.batch).emplace_back());
+            if (!writer.writing) submit(writer.batch);
+        }
+
+        if (sampled) {
+            metrics.recordEnqueueLatency(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+        }
+
+        // ʱ FATAL ͬдδ̵ļ¼
+        if (level == LogLevel::FATAL && pendingRecords.isEnabled()) {
+            drainPendingRecords(false);
+        }
     }
 
-    inline void PebbleLog::formatLogMessage(LogLevel level, const std::string &message, std::string &formattedMessage) {
-        auto now = std::time(nullptr);
-        auto tm = *std::localtime(&now);
+    inline void PebbleLog::enableBacktrace(size_t count) { backtrace.resize(count); }
+    inline void PebbleLog::disableBacktrace() { backtrace.resize(0); }
+
+    inline void PebbleLog::dumpBacktrace() {
+        std::vector<LogRecord> entries;
+        TimestampClock::Calibration calibration = clock.calibration();
+        backtrace.drain([&entries, &calibration](const BacktraceRing::Entry &entry) {
+#ifndef _WIN32
+            if (SharedRing *ring = sharedRing.load(std::memory_order_acquire)) {
+                ring->push(entry.level, calibration.toWallNanos(entry.stamp), entry.threadId, entry.message);
+                return;
+            }
+#endif
+            LogRecord &record = entries.emplace_back();
+            record.level = entry.level;
+            record.timestamp = entry.stamp.ticks;// ʹü¼ʱʱ
+            record.clockKind = entry.stamp.kind;
+            record.threadId = entry.threadId;
+            if (pendingRecords.isEnabled()) {
+                record.crashTicket = trackForCrash(entry.level, calibration.toWallNanos(entry.stamp), entry.message);
+            }
+            record.assign(entry.message, spillFor(entry.message));
+            metrics.recordEnqueue(entry.level);
+        });
+        if (entries.empty()) return;
+
+        // ӻд֤ݼ¼
+        submit(entries);
+    }
 
-        // ʹ std::strftime  std::format ʱʽ
-        char timeBuffer[20];
-        std::strftime(timeBuffer, sizeof(timeBuffer), defalut::timeFormat.c_str(), &tm);
-        std::string timeStr(timeBuffer);
+    inline void PebbleLog::formatLogMessage(const PatternFormatter::Context &context, std::string_view message, std::string &formattedMessage,
+                                            PatternFormatter &formatter) {
+        PatternFormatter &pattern = prepareFormatter(formatter);
+        pattern.appendPrefix(context, formattedMessage);
+        if (pattern.escaping() == escape::Mode::NONE) {
+            formattedMessage.append(message);
+        } else {
+            escape::append(message, pattern.escaping(), formattedMessage);
+        }
+        pattern.appendSuffix(context, formattedMessage);
+    }
 
-        formattedMessage = std::format("[{}] {}[{}] {}", timeStr, defalut::filePrefixFormat.empty() ? "" : defalut::filePrefixFormat + " ", [&]() -> std::string {
-                                   switch (level) {
-                                       case LogLevel::INFO: return "INFO";
-                                       case LogLevel::DEBUG: return "DEBUG";
-                                       case LogLevel::WARN: return "WARN";
-                                       case LogLevel::ERROR: return "ERROR";
-                                       case LogLevel::FATAL: return "FATAL";
-                                       case LogLevel::TRACE: return "TRACE";
-                                       default: return "UNKNOWN";
-                                   } }(), message);
+    inline PatternFormatter &PebbleLog::prepareFormatter(PatternFormatter &formatter) {
+        // ȶ汾ٶãʹµã´Ҳ汾ͬٱһ
+        uint32_t version = formatVersion.load(std::memory_order_acquire);
+        if (!formatter.isCompiled(version)) formatter.compile(*configStore.read(), version);
+        return formatter;
     }
 
 #ifdef _WIN32
-    inline void PebbleLog::writeLogToConsole(LogLevel level, const std::string &message) {
-        static HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
+    inline void PebbleLog::writeLogToConsole(LogLevel level, std::string_view prefix, std::string_view message, std::string_view suffix) {
+        HANDLE hConsole = GetStdHandle(consoleFd.load(std::memory_order_relaxed) == io::stderrFd ? STD_ERROR_HANDLE : STD_OUTPUT_HANDLE);
         if (hConsole == INVALID_HANDLE_VALUE) return;
 
         // ɫ
@@ -599,81 +5395,181 @@ namespace utils::Log {
 
         // дϢ
         DWORD written;
-        WriteConsoleA(hConsole, message.c_str(), static_cast<DWORD>(message.size()), &written, nullptr);
+        WriteConsoleA(hConsole, prefix.data(), static_cast<DWORD>(prefix.size()), &written, nullptr);
+        WriteConsoleA(hConsole, message.data(), static_cast<DWORD>(message.size()), &written, nullptr);
+        WriteConsoleA(hConsole, suffix.data(), static_cast<DWORD>(suffix.size()), &written, nullptr);
         WriteConsoleA(hConsole, "\n", 1, &written, nullptr);// з
 
         // ָĬɫ
         SetConsoleTextAttribute(hConsole, FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE);
     }
+
+    // Windows ̨¼лɫֱд軺
+    inline void PebbleLog::flushConsole() {}
+    inline void PebbleLog::retainConsole() {}
 #endif
 
 #ifndef _WIN32
-    inline void PebbleLog::writeLogToConsole(LogLevel level, const std::string &message) {
-        // ʹ ANSI ת
-        const char *colorCode = "";
-        switch (level) {
-            case LogLevel::INFO:
-                colorCode = "\033[32m";
-                break;
-            case LogLevel::DEBUG:
-                colorCode = "\033[36m";
-                break;
-            case LogLevel::WARN:
-                colorCode = "\033[33m";
-                break;
-            case LogLevel::ERROR:
-                colorCode = "\033[31m";
-                break;
-            case LogLevel::FATAL:
-                colorCode = "\033[35m";
-                break;
-            case LogLevel::TRACE:
-                colorCode = "\033[34m";
-                break;
-            default:
-                colorCode = "\033[0m";
-                break;
+    namespace console {
+        // ANSI ɫа LogLevel ˳ھ̬洢УΪ writev Ķֶ
+        constexpr std::string_view colorCodes[] = {
+                "\033[36m",// DEBUG
+                "\033[32m",// INFO
+                "\033[33m",// WARN
+                "\033[31m",// ERROR
+                "\033[35m",// FATAL
+                "\033[34m" // TRACE
+        };
+        constexpr std::string_view resetAndNewline = "\033[0m\n";
+        constexpr std::string_view newline = "\n";
+
+        inline iovec segment(std::string_view text) {
+            return {const_cast<char *>(text.data()), text.size()};
         }
+    }// namespace console
+
+    // ƴַɫǰ׺Ϣ׺λΪֶΣһ writev
+    inline void PebbleLog::writeLogToConsole(LogLevel level, std::string_view prefix, std::string_view message, std::string_view suffix) {
+        bool colored = consoleColors.load(std::memory_order_relaxed);
+        std::string_view color = colored ? console::colorCodes[static_cast<size_t>(level)] : std::string_view();
+        std::string_view end = colored ? console::resetAndNewline : console::newline;
+        if (colored) consoleIov.push_back(console::segment(color));
+        consoleIov.push_back(console::segment(prefix));
+        consoleIov.push_back(console::segment(message));
+        if (!suffix.empty()) consoleIov.push_back(console::segment(suffix));
+        consoleIov.push_back(console::segment(end));
+        consoleBytes += color.size() + prefix.size() + message.size() + suffix.size() + end.size();
+        if (consoleBytes >= kSinkBufferSize) flushConsole();
+    }
 
-        // ϵͳ
-        std::string output = colorCode + message + "\033[0m\n";
-        ssize_t result = write(STDOUT_FILENO, output.c_str(), output.size());
-        if (result == -1) {
+    inline void PebbleLog::flushConsole() {
+        if (consoleIov.empty()) return;
+        auto start = std::chrono::steady_clock::now();
+        size_t written = io::writevAll(consoleFd.load(std::memory_order_relaxed), consoleIov.data(), consoleIov.size());
+        metrics.recordWrite(written, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+        if (written < consoleBytes) {
             // ÷ʹ cerrݹã
             std::cerr << "Console write failed: " << strerror(errno) << std::endl;
-            //ֱlinux
-        }
-    }
-#endif
-
-    // ļ֧ת
-    inline void PebbleLog::writeLogToFile(const std::string &message) {
-        std::filesystem::create_directories(logProperty.logPath);
-        std::string fullPath = logProperty.logPath + "/" + logProperty.logName;
-
-        // ļС
-        std::ifstream inFile(fullPath, std::ios::ate);
-        if (inFile.is_open() && inFile.tellg() >= static_cast<std::streampos>(logProperty.maxFileSize)) {
-            inFile.close();
-            //  maxFileCount - 1  1 ļ
-            for (int i = logProperty.maxFileCount - 1; i > 0; --i) {
-                std::string oldName = fullPath + "." + std::to_string(i - 1);
-                std::string newName = fullPath + "." + std::to_string(i);
-                if (std::filesystem::exists(oldName)) {
-                    try {
-                        std::filesystem::rename(oldName, newName);
-                    } catch (const std::filesystem::filesystem_error &e) {
-                        error("Filesystem error: " + std::string(e.what()));
-                    } catch (const std::exception &e) {
-                        error("General error: " + std::string(e.what()));
-                    }
-                }
+        }
+        consoleIov.clear();
+        consoleCarry.clear();
+        consoleBytes = 0;
+    }
+
+    // еķֶ׷ӸƵ consoleCarryָֻ֮һֶΣѱĲֲٸ
+    inline void PebbleLog::retainConsole() {
+        if (consoleIov.empty()) return;
+        for (size_t i = consoleCarry.empty() ? 0 : 1; i < consoleIov.size(); ++i) {
+            consoleCarry.append(static_cast<const char *>(consoleIov[i].iov_base), consoleIov[i].iov_len);
+        }
+        consoleIov.assign(1, console::segment(consoleCarry));
+    }
+#endif
+
+    // ļ֧תд뻺壬ˢ²Ծʱ
+    inline void PebbleLog::writeLogToFile(const LogRecord &record, std::string_view prefix, std::string_view message, std::string_view suffix) {
+        if (logFile.fd < 0 || logFile.version != pathVersion.load(std::memory_order_acquire)) {
+            openLogFile();
+            if (logFile.fd < 0) {
+                metrics.recordDropped();
+                return;
+            }
+        }
+
+        // д󳬹СתѹʱдѹСж
+        ConfigStore::Reader config = configStore.read();
+        bool compressed = logFile.compression != FileCompression::NONE;
+        size_t length = prefix.size() + message.size() + suffix.size() + 1;
+        size_t pending = compressed ? 0 : logFile.buffer.size();
+        if (logFile.size + pending > 0 && logFile.size + pending + length > config->maxFileSize) {
+            rotateLogFile();
+            if (logFile.fd < 0) {
+                metrics.recordDropped();
+                return;
+            }
+        }
+
+        if (compressed) {
+            int64_t wallNanos = static_cast<int64_t>(record.timestamp);
+            framefile::Header &frame = logFile.frame;
+            if (frame.records++ == 0) frame.firstNanos = frame.minNanos = frame.maxNanos = wallNanos;
+            frame.minNanos = std::min(frame.minNanos, wallNanos);
+            frame.maxNanos = std::max(frame.maxNanos, wallNanos);
+            frame.levelMask |= 1u << static_cast<uint32_t>(record.level);
+        } else if (config->fileIndex.enabled()) {
+            indexRecord(record, length, config->fileIndex);
+        }
+        logFile.buffer.append(prefix).append(message).append(suffix).push_back('\n');
+        ++logFile.records;
+        if (logFile.buffer.size() >= (compressed ? std::min(config->compression.frameSize, framefile::kMaxFrameSize) : kSinkBufferSize)) writeFileBuffer();
+    }
+
+    inline std::string PebbleLog::logFilePath(const LogConfig &config) {
+        std::string fullPath = config.logPath + "/" + config.logName;
+        return config.compression.enabled() ? framefile::pathFor(fullPath) : fullPath;
+    }
+
+    inline void PebbleLog::openLogFile() {
+        closeLogFile();
+        logFile.version = pathVersion.load(std::memory_order_acquire);
+
+        ConfigStore::Reader config = configStore.read();
+        std::error_code ec;
+        std::filesystem::create_directories(config->logPath, ec);
+        std::string fullPath = logFilePath(*config);
+        logFile.compression = config->compression.codec;
+        bool direct = false;
+#ifndef _WIN32
+        if (config->fileIo.directIo) {
+            logFile.fd = io::openForDirectWrite(fullPath.c_str());
+            direct = logFile.fd >= 0;
+            static bool reported = false;// ֻɺ̷̨߳ʣÿת´򿪣ֻʾһ
+            if (!direct && !std::exchange(reported, true)) {
+                std::cerr << "Direct I/O is not supported for " << fullPath << ", using buffered writes" << std::endl;
             }
-            // ǰļΪ fullPath.1
-            std::string newName = fullPath + ".1";
-            if (std::filesystem::exists(fullPath)) {
+        }
+#endif
+        if (!direct) logFile.fd = logFile.compression != FileCompression::NONE ? io::openForWrite(fullPath.c_str()) : io::openForAppend(fullPath.c_str());
+        if (logFile.fd < 0) {
+            //  error()дļʧܻٴν
+            std::cerr << "Failed to open log file: " << fullPath << std::endl;
+            return;
+        }
+        auto size = std::filesystem::file_size(fullPath, ec);
+        logFile.size = ec ? 0 : static_cast<size_t>(size);
+        logFile.path = std::move(fullPath);
+        if (config->fileIo.preallocate && logFile.size < config->maxFileSize) logFile.preallocated = io::preallocate(logFile.fd, config->maxFileSize);
+#ifndef _WIN32
+        if (direct) {
+            logFile.direct = std::make_unique<DirectFileWriter>(logFile.fd, logFile.size, config->fileIo.stagingSize);
+            logFile.size = static_cast<size_t>(logFile.direct->size());
+            crashDirect.store(logFile.direct.get(), std::memory_order_release);
+        }
+#endif
+        // ־ļ½ģֻͬǲģеƫѾʧЧ
+        if (logFile.size == 0) std::filesystem::remove(fileindex::pathFor(logFile.path), ec);
+    }
+
+    inline void PebbleLog::rotateLogFile() {
+        closeLogFile();
+        metrics.recordRotation();
+
+        LogConfig config = getConfig();// תп־ȡһݸ
+        std::string fullPath = logFilePath(config);
+        // ־ļûļĿλϾļ
+        auto moveIndex = [](const std::string &from, const std::string &to) {
+            std::error_code ec;
+            std::filesystem::remove(fileindex::pathFor(to), ec);
+            if (std::filesystem::exists(fileindex::pathFor(from), ec)) std::filesystem::rename(fileindex::pathFor(from), fileindex::pathFor(to), ec);
+        };
+        //  maxFileCount - 1  2 κƱļɵı
+        for (int i = static_cast<int>(config.maxFileCount) - 1; i > 1; --i) {
+            std::string oldName = fullPath + "." + std::to_string(i - 1);
+            std::string newName = fullPath + "." + std::to_string(i);
+            if (std::filesystem::exists(oldName)) {
                 try {
-                    std::filesystem::rename(fullPath, newName);
+                    std::filesystem::rename(oldName, newName);
+                    moveIndex(oldName, newName);
                 } catch (const std::filesystem::filesystem_error &e) {
                     error("Filesystem error: " + std::string(e.what()));
                 } catch (const std::exception &e) {
@@ -681,13 +5577,267 @@ namespace utils::Log {
                 }
             }
         }
+        // ǰļΪ fullPath.1
+        std::string newName = fullPath + ".1";
+        if (config.maxFileCount > 1 && std::filesystem::exists(fullPath)) {
+            try {
+                std::filesystem::rename(fullPath, newName);
+                moveIndex(fullPath, newName);
+            } catch (const std::filesystem::filesystem_error &e) {
+                error("Filesystem error: " + std::string(e.what()));
+            } catch (const std::exception &e) {
+                error("General error: " + std::string(e.what()));
+            }
+        } else {
+            std::error_code ec;
+            std::filesystem::remove(fullPath, ec);
+        }
+        openLogFile();
+    }
+
+    // ǰг־ûʱرǰ֤ͬתǰдļļ¼Ҳ
+    inline void PebbleLog::closeLogFile() {
+        closeIndexBlock();
+        writeFileBuffer();// ǰ֡
+        flushFile();
+        if (logFile.indexFd >= 0) {
+            io::closeFd(logFile.indexFd);
+            logFile.indexFd = -1;
+        }
+        if (logFile.fd < 0) return;
+        // ض֮ͬǰļȵı仯Ҳһ
+        if (logFile.direct) {
+            crashDirect.store(nullptr, std::memory_order_release);
+            if (!logFile.direct->finish() && !durableRequests.empty()) durableSyncFailed = true;
+            logFile.direct.reset();
+        } else if (logFile.preallocated) {
+            io::truncate(logFile.fd, logFile.size);
+        }
+        logFile.preallocated = false;
+        if (!durableRequests.empty()) {
+            if (io::syncData(logFile.fd)) {
+                metrics.recordSync();
+            } else {
+                durableSyncFailed = true;
+            }
+        }
+        io::closeFd(logFile.fd);
+        logFile.fd = -1;
+        logFile.tailRaw = 0;
+        logFile.tailLength = 0;
+    }
+
+    // ѻеݽļѹʱȱһ֡ǰֱ֡дʱƵݴдĿд߳д
+    inline void PebbleLog::writeFileBuffer() {
+        if (logFile.buffer.empty()) return;
+        if (logFile.fd >= 0) {
+            std::string_view data = logFile.buffer;
+            if (logFile.compression != FileCompression::NONE) {
+                logFile.frameBuffer.clear();
+                framefile::encode(data, logFile.compression, logFile.frame, logFile.frameBuffer);
+                data = logFile.frameBuffer;
+            }
+            if (!writeFileData(data)) metrics.recordDropped(logFile.records);
+        }
+        logFile.buffer.clear();
+        logFile.records = 0;
+        logFile.frame = {};
+        logFile.tailRaw = 0;
+    }
 
-        std::ofstream outFile(fullPath, std::ios::app);
-        if (outFile.is_open()) {
-            outFile << message << std::endl;
-            outFile.close();
+    // ļ size λд벢 sizeѹ֮ǰдδ֡
+    // дʧʱ size־ûʧȷϣֱдĴ flush  finish 
+    inline bool PebbleLog::writeFileData(std::string_view data) {
+        auto start = std::chrono::steady_clock::now();
+        bool ok = true;
+        if (logFile.direct) {
+            logFile.direct->append(data);
+        } else if (logFile.compression != FileCompression::NONE) {
+            ok = io::writeAllAt(logFile.fd, data.data(), data.size(), logFile.size);
+            // ֮ǰдδ֡ʱصĲֽ֣ڻᱻһ֡
+            if (ok && data.size() < logFile.tailLength) io::truncate(logFile.fd, logFile.size + data.size());
         } else {
-            error("Failed to open log file: " + fullPath);
+            ok = io::writeAll(logFile.fd, data.data(), data.size());
+        }
+        if (!ok) {
+            if (!durableRequests.empty()) durableSyncFailed = true;
+            // size ֮дһֵݣѹ´дʱϳһνض
+            if (logFile.compression != FileCompression::NONE) logFile.tailLength = std::max(logFile.tailLength, data.size());
+            return false;
+        }
+        metrics.recordWrite(data.size(), std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+        logFile.size += data.size();
+        logFile.tailLength = 0;
+        return true;
+    }
+
+    // ѹֻ֡ڴﵽ frameSize ʱˢʱδ֡дύ֮󣬲 size
+    // ȡ֮֡ۻ´ˢ»һ֡ʱԭλǡֱдʱͬһҳĽβһд
+    inline void PebbleLog::flushFile() {
+        bool ok = true;
+        if (logFile.compression == FileCompression::NONE || logFile.buffer.empty()) {
+            writeFileBuffer();
+            if (logFile.direct) ok = logFile.direct->flush();
+        } else if (logFile.fd >= 0) {
+            if (logFile.unflushed() > 0) {
+                auto start = std::chrono::steady_clock::now();
+                logFile.frameBuffer.clear();
+                framefile::encode(logFile.buffer, logFile.compression, logFile.frame, logFile.frameBuffer);
+                logFile.tailRaw = logFile.buffer.size();
+                if (!logFile.direct) {
+                    ok = io::writeAllAt(logFile.fd, logFile.frameBuffer.data(), logFile.frameBuffer.size(), logFile.size);
+                    if (ok && logFile.frameBuffer.size() < logFile.tailLength) io::truncate(logFile.fd, logFile.size + logFile.frameBuffer.size());
+                    logFile.tailLength = ok ? logFile.frameBuffer.size() : std::max(logFile.tailLength, logFile.frameBuffer.size());
+                }
+                if (ok) {
+                    metrics.recordWrite(logFile.frameBuffer.size(),
+                                        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+                } else {
+                    logFile.tailRaw = 0;// ¼ buffer У´ˢ»һ֡ʱд
+                }
+            }
+            // ֱдÿζҪδ֡ĽβḲ
+            if (logFile.direct) ok = logFile.direct->flush(logFile.frameBuffer);
+        }
+        if (!ok && !durableRequests.empty()) durableSyncFailed = true;
+        // ־֮дȡĿָѾд
+        if (!logFile.indexBuffer.empty()) {
+            if (logFile.indexFd >= 0) io::writeAll(logFile.indexFd, logFile.indexBuffer.data(), logFile.indexBuffer.size());
+            logFile.indexBuffer.clear();
+        }
+    }
+
+    // ǰδﵽʱʱ¼ʼµһ
+    inline void PebbleLog::indexRecord(const LogRecord &record, size_t length, const FileIndexPolicy &policy) {
+        int64_t wallNanos = static_cast<int64_t>(record.timestamp);
+        fileindex::Entry &block = logFile.block;
+        if (logFile.blockOpen) {
+            bool full = policy.records > 0 && block.records >= policy.records;
+            bool expired = policy.interval.count() > 0 &&
+                           wallNanos - block.minNanos >= std::chrono::duration_cast<std::chrono::nanoseconds>(policy.interval).count();
+            if (full || expired) closeIndexBlock();
+        }
+        if (!logFile.blockOpen) {
+            block = {wallNanos, wallNanos, logFile.size + logFile.buffer.size(), 0, 0, 0};
+            logFile.blockOpen = true;
+        }
+        block.minNanos = std::min(block.minNanos, wallNanos);
+        block.maxNanos = std::max(block.maxNanos, wallNanos);
+        block.length += length;
+        ++block.records;
+        block.levelMask |= 1u << static_cast<uint32_t>(record.level);
+    }
+
+    inline void PebbleLog::closeIndexBlock() {
+        if (!logFile.blockOpen) return;
+        logFile.blockOpen = false;
+        if (logFile.indexFd < 0) {
+            std::string path = fileindex::pathFor(logFile.path);
+            logFile.indexFd = io::openForAppend(path.c_str());
+            if (logFile.indexFd < 0) return;
+            std::error_code ec;
+            if (std::filesystem::file_size(path, ec) == 0 && !ec) logFile.indexBuffer.append(fileindex::kMagic, sizeof(fileindex::kMagic));
+        }
+        logFile.indexBuffer.append(reinterpret_cast<const char *>(&logFile.block), sizeof(fileindex::Entry));
+    }
+
+    namespace crash {
+#ifdef _WIN32
+        constexpr int signals[] = {SIGSEGV, SIGABRT, SIGFPE};
+        using Handler = void (*)(int);
+        inline Handler previousHandlers[std::size(signals)] = {};
+#else
+        constexpr int signals[] = {SIGSEGV, SIGABRT, SIGBUS, SIGFPE};
+        inline struct sigaction previousActions[std::size(signals)] = {};
+#endif
+        inline std::atomic<bool> installed{false};
+        inline std::atomic_flag handling = ATOMIC_FLAG_INIT;
+    }// namespace crash
+
+    inline void PebbleLog::updateCrashLogPath() {
+        // ޸ʱ·м logMutex ÷ﲻ
+        static std::mutex pathMutex;
+        std::lock_guard<std::mutex> lock(pathMutex);
+        ConfigStore::Reader config = configStore.read();
+        // ѹʱҲдδѹļ׷ӵ֮֡ƻѹļ
+        std::snprintf(crashLogPath, sizeof(crashLogPath), "%s/%s", config->logPath.c_str(), config->logName.c_str());
+        crashLogType.store(config->type, std::memory_order_relaxed);
+    }
+
+    // źŴвȡÿգֻʹԤдõ·
+    inline void PebbleLog::drainPendingRecords(bool includeInFlight) {
+        LogType type = crashLogType.load(std::memory_order_relaxed);
+        bool toConsole = type == LogType::CONSOLE || type == LogType::BOTH;
+        int fileFd = -1;
+        if (type == LogType::FILE || type == LogType::BOTH) {
+            fileFd = io::openForAppend(crashLogPath);
+        }
+        pendingRecords.drain(includeInFlight, [&](const char *data, size_t length) {
+            if (toConsole) {
+                io::writeAll(consoleFd.load(std::memory_order_relaxed), data, length);
+            }
+            if (fileFd >= 0) {
+                io::writeAll(fileFd, data, length);
+            }
+        });
+        if (fileFd >= 0) io::closeFd(fileFd);
+    }
+
+    inline void PebbleLog::crashSignalHandler(int sig) {
+        // ֹдٴαµݹ
+        if (!crash::handling.test_and_set()) {
+#ifndef _WIN32
+            // ֱдļβҳ㣬صʵʳȣ¼֮´δҲѲ㵱
+            if (DirectFileWriter *direct = crashDirect.load(std::memory_order_acquire)) direct->truncateToWritten();
+#endif
+            drainPendingRecords(true);// дļ¼ҲһдظҲʧ
+        }
+
+        // ָԭдʽ׳ź
+        for (size_t i = 0; i < std::size(crash::signals); ++i) {
+            if (crash::signals[i] != sig) continue;
+#ifdef _WIN32
+            std::signal(sig, crash::previousHandlers[i] ? crash::previousHandlers[i] : SIG_DFL);
+#else
+            sigaction(sig, &crash::previousActions[i], nullptr);
+#endif
+        }
+        std::raise(sig);
+    }
+
+    inline void PebbleLog::installCrashHandler(size_t capacity) {
+        if (crash::installed.exchange(true)) return;
+        getInstance();// ȷ̨߳
+        pendingRecords.enable(capacity);
+        updateCrashLogPath();
+        LogConfig config = getConfig();
+        if (config.type == LogType::FILE || config.type == LogType::BOTH) {
+            std::error_code ec;
+            std::filesystem::create_directories(config.logPath, ec);
+        }
+
+        for (size_t i = 0; i < std::size(crash::signals); ++i) {
+#ifdef _WIN32
+            crash::previousHandlers[i] = std::signal(crash::signals[i], &PebbleLog::crashSignalHandler);
+#else
+            struct sigaction action = {};
+            action.sa_handler = &PebbleLog::crashSignalHandler;
+            sigemptyset(&action.sa_mask);
+            action.sa_flags = SA_NODEFER;
+            sigaction(crash::signals[i], &action, &crash::previousActions[i]);
+#endif
+        }
+    }
+
+    inline void PebbleLog::uninstallCrashHandler() {
+        if (!crash::installed.exchange(false)) return;
+        for (size_t i = 0; i < std::size(crash::signals); ++i) {
+#ifdef _WIN32
+            std::signal(crash::signals[i], crash::previousHandlers[i] ? crash::previousHandlers[i] : SIG_DFL);
+#else
+            sigaction(crash::signals[i], &crash::previousActions[i], nullptr);
+#endif
         }
+        pendingRecords.disable();
     }
 }// namespace utils::Log
@@ -1,111 +1,162 @@
 #include"../PebbleLog_ho.hpp"
+#include <algorithm>
+#include <chrono>
 #include <string>
+#include <vector>
 #include<benchmark/benchmark.h>
 
-// 初始化日志库
-static void initLogger() {
-    using namespace utils::Log;
-
-    // 配置日志
-    PebbleLog::setLogLevel(LogLevel::DEBUG);
-    PebbleLog::setLogType(LogType::CONSOLE);
-    PebbleLog::setLogPath("./bench_logs");
-    PebbleLog::setLogName("bench.log");
-    PebbleLog::setMaxFileSize(10 * 1024 * 1024); // 10MB
-    PebbleLog::setMaxFileCount(5);
-}
+// 每个线程的调用延迟采样，每 kSampleEvery 次调用计时一次，避免计时本身拖慢吞吐
+class LatencySampler {
+public:
+    static constexpr int64_t kSampleEvery = 16;
 
-// 测试 info 级别的日志记录
-static void BM_LogInfo(benchmark::State& state) {
-    using namespace utils::Log;
-
-    initLogger();
-
-    // Warm-up 阶段
-    for (int i = 0; i < state.range(0); ++i) {
-        PebbleLog::info("This is an info message.");
+    explicit LatencySampler(benchmark::State &state) : state_(state) {
+        samples_.reserve(1 << 16);
     }
 
-    // 实际测试阶段
-    for (auto _ : state) {
-        PebbleLog::info("This is an info message.");
+    template<typename Func>
+    void run(Func &&func) {
+        if (++counter_ % kSampleEvery != 0) {
+            func();
+            return;
+        }
+        auto start = std::chrono::steady_clock::now();
+        func();
+        auto end = std::chrono::steady_clock::now();
+        samples_.push_back(std::chrono::duration<double, std::nano>(end - start).count());
     }
-}
 
-// 测试 debug 级别的日志记录
-static void BM_LogDebug(benchmark::State& state) {
-    using namespace utils::Log;
+    // 输出 p50/p99/p99.9，多线程时取各线程的平均值
+    void report() {
+        if (samples_.empty()) return;
+        std::sort(samples_.begin(), samples_.end());
+        auto at = [this](double p) { return samples_[std::min(samples_.size() - 1, static_cast<size_t>(p * samples_.size()))]; };
+        state_.counters["p50_ns"] = benchmark::Counter(at(0.50), benchmark::Counter::kAvgThreads);
+        state_.counters["p99_ns"] = benchmark::Counter(at(0.99), benchmark::Counter::kAvgThreads);
+        state_.counters["p999_ns"] = benchmark::Counter(at(0.999), benchmark::Counter::kAvgThreads);
+    }
 
-    initLogger();
+private:
+    benchmark::State &state_;
+    std::vector<double> samples_;
+    int64_t counter_ = 0;
+};
 
-    // Warm-up 阶段
-    for (int i = 0; i < state.range(0); ++i) {
-        PebbleLog::debug("This is a debug message.");
-    }
+// 循环结束后等待后台把本线程记录全部写出，统计端到端吞吐（各线程求和）
+template<typename Func>
+static void runCase(benchmark::State &state, Func &&func) {
+    using namespace utils::Log;
 
-    // 实际测试阶段
+    LatencySampler sampler(state);
+    auto start = std::chrono::steady_clock::now();
     for (auto _ : state) {
-        PebbleLog::debug("This is a debug message.");
+        sampler.run(func);
     }
+    PebbleLog::flush();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    sampler.report();
+    state.SetItemsProcessed(state.iterations());
+    state.counters["e2e_items_per_second"] = benchmark::Counter(static_cast<double>(state.iterations()) / seconds);
 }
 
-// 测试 warn 级别的日志记录
-static void BM_LogWarn(benchmark::State& state) {
+// 每个用例开始前切换输出目标，结束后排空队列，避免上一个用例的积压影响下一个
+static void configure(utils::Log::LogType type, utils::Log::LogLevel level = utils::Log::LogLevel::DEBUG) {
     using namespace utils::Log;
 
-    initLogger();
+    PebbleLog::flush();
+    PebbleLog::setLogLevel(level);
+    PebbleLog::setLogType(type);
+    PebbleLog::setLogPath("./bench_logs");
+    PebbleLog::setLogName("bench.log");
+    PebbleLog::setMaxFileSize(10 * 1024 * 1024);// 10MB
+    PebbleLog::setMaxFileCount(5);
+}
 
-    // Warm-up 阶段
-    for (int i = 0; i < state.range(0); ++i) {
-        PebbleLog::warn("This is a warning message.");
-    }
+static void setupNullSink(const benchmark::State &) { configure(utils::Log::LogType::NONE); }
+static void setupFileSink(const benchmark::State &) { configure(utils::Log::LogType::FILE); }
+static void setupFiltered(const benchmark::State &) { configure(utils::Log::LogType::NONE, utils::Log::LogLevel::INFO); }
+static void drain(const benchmark::State &) { utils::Log::PebbleLog::flush(); }
 
-    // 实际测试阶段
-    for (auto _ : state) {
-        PebbleLog::warn("This is a warning message.");
-    }
+static void setupMemorySink(const benchmark::State &) {
+    configure(utils::Log::LogType::NONE);
+    utils::Log::PebbleLog::enableMemorySink(4096);
+}
+
+static void drainMemorySink(const benchmark::State &) {
+    utils::Log::PebbleLog::flush();
+    utils::Log::PebbleLog::disableMemorySink();
 }
 
-// 测试 error 级别的日志记录
-static void BM_LogError(benchmark::State& state) {
+// 常量字符串，空输出：只衡量前端和后台调度开销
+static void BM_NullSinkConstant(benchmark::State &state) {
     using namespace utils::Log;
+    runCase(state, [] { PebbleLog::info("This is an info message."); });
+}
 
-    initLogger();
+// 常量字符串，写入内存环形输出
+static void BM_MemorySinkConstant(benchmark::State &state) {
+    using namespace utils::Log;
+    runCase(state, [] { PebbleLog::info("This is an info message."); });
+}
 
-    // Warm-up 阶段
-    for (int i = 0; i < state.range(0); ++i) {
-        PebbleLog::error("This is an error message.");
-    }
+// 常量字符串，写文件
+static void BM_FileSinkConstant(benchmark::State &state) {
+    using namespace utils::Log;
+    runCase(state, [] { PebbleLog::info("This is an info message."); });
+}
 
-    // 实际测试阶段
-    for (auto _ : state) {
-        PebbleLog::error("This is an error message.");
-    }
+// 混合类型参数的格式化
+static void BM_NullSinkFormatted(benchmark::State &state) {
+    using namespace utils::Log;
+    static const std::string user = "pebble";
+    int64_t i = 0;
+    runCase(state, [&i] {
+        ++i;
+        PebbleLog::info("user={} id={} ratio={:.3f} ok={} path={}", user, i, static_cast<double>(i) / 7.0, (i & 1) == 0, "/api/v1/items");
+    });
 }
 
-// 测试 fatal 级别的日志记录
-static void BM_LogFatal(benchmark::State& state) {
+static void BM_FileSinkFormatted(benchmark::State &state) {
     using namespace utils::Log;
+    static const std::string user = "pebble";
+    int64_t i = 0;
+    runCase(state, [&i] {
+        ++i;
+        PebbleLog::info("user={} id={} ratio={:.3f} ok={} path={}", user, i, static_cast<double>(i) / 7.0, (i & 1) == 0, "/api/v1/items");
+    });
+}
 
-    initLogger();
+// 左移运算符接口
+static void BM_LogStream(benchmark::State &state) {
+    using namespace utils::Log;
+    int64_t i = 0;
+    runCase(state, [&i] { PebbleLog::log() << "stream message " << ++i << " ratio " << 0.5; });
+}
 
-    // Warm-up 阶段
-    for (int i = 0; i < state.range(0); ++i) {
-        PebbleLog::fatal("This is a fatal message.");
-    }
+// 被级别过滤掉的调用，应当接近零开销
+static void BM_FilteredOut(benchmark::State &state) {
+    using namespace utils::Log;
+    int64_t i = 0;
+    runCase(state, [&i] { PebbleLog::debug("filtered {} {}", ++i, "message"); });
+}
 
-    // 实际测试阶段
-    for (auto _ : state) {
-        PebbleLog::fatal("This is a fatal message.");
-    }
+// 函数跟踪，每次调用产生两条 TRACE 记录
+static void BM_TraceFunction(benchmark::State &state) {
+    using namespace utils::Log;
+    int a = 1;
+    runCase(state, [&a] { PEBBLETRACE([](int x, int y) { return x + y; }, a, 2); });
 }
 
-// 注册基准测试
-BENCHMARK(BM_LogInfo)->Arg(1000);
-BENCHMARK(BM_LogDebug)->Arg(1000);
-BENCHMARK(BM_LogWarn)->Arg(1000);
-BENCHMARK(BM_LogError)->Arg(1000);
-BENCHMARK(BM_LogFatal)->Arg(1000);
+// 注册基准测试，多生产者用例覆盖 1~64 个线程
+BENCHMARK(BM_NullSinkConstant)->Setup(setupNullSink)->Teardown(drain)->ThreadRange(1, 64)->UseRealTime();
+BENCHMARK(BM_MemorySinkConstant)->Setup(setupMemorySink)->Teardown(drainMemorySink)->ThreadRange(1, 64)->UseRealTime();
+BENCHMARK(BM_FileSinkConstant)->Setup(setupFileSink)->Teardown(drain)->ThreadRange(1, 64)->UseRealTime();
+BENCHMARK(BM_NullSinkFormatted)->Setup(setupNullSink)->Teardown(drain)->ThreadRange(1, 64)->UseRealTime();
+BENCHMARK(BM_FileSinkFormatted)->Setup(setupFileSink)->Teardown(drain)->ThreadRange(1, 64)->UseRealTime();
+BENCHMARK(BM_LogStream)->Setup(setupNullSink)->Teardown(drain)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK(BM_FilteredOut)->Setup(setupFiltered)->Teardown(drain)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK(BM_TraceFunction)->Setup(setupNullSink)->Teardown(drain)->ThreadRange(1, 8)->UseRealTime();
 
 // 运行所有注册的基准测试
-BENCHMARK_MAIN();
\ No newline at end of file
+BENCHMARK_MAIN();
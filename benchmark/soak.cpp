@@ -0,0 +1,312 @@
+#include "../PebbleLog_ho.hpp"
+#include <algorithm>
+#include <charconv>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+// 端到端压力测试：多个生产者以最快速度写文件输出（包括轮转），每秒报告吞吐、写出速度、内存和积压，
+// 结束后读回所有日志文件，检查每个线程的记录没有丢失、重复或乱序，内容没有被截断或交错。
+//
+//   soakLog [--threads N] [--size 字节|最小-最大] [--duration 秒] [--dir 目录]
+//           [--max-file-size 大小] [--max-files N] [--direct] [--sync] [--no-verify]
+//
+// 大小可带 K/M/G 后缀。轮转删除了最早的文件时，只检查保留下来的部分是否连续
+
+using namespace utils::Log;
+
+namespace {
+    constexpr std::string_view kLogName = "soak.log";
+    constexpr std::string_view kMarker = "soak t=";
+
+    struct Options {
+        size_t threads = 4;
+        size_t minSize = 100;
+        size_t maxSize = 100;
+        std::chrono::seconds duration{10};
+        std::string dir = "./soak_logs";
+        size_t maxFileSize = 64 * 1024 * 1024;
+        size_t maxFiles = 20;
+        bool direct = false;
+        bool sync = false;// 使用 BackendMode::SYNC，在生产者线程写出
+        bool verify = true;
+    };
+
+    // 消息长度由线程和序号决定，校验时据此判断内容是否完整
+    size_t payloadSize(const Options &options, size_t thread, uint64_t seq) {
+        if (options.minSize == options.maxSize) return options.minSize;
+        uint64_t hash = (seq + 1) * 0x9E3779B97F4A7C15ull ^ (thread + 1) * 0xC2B2AE3D27D4EB4Full;
+        hash ^= hash >> 29;
+        return options.minSize + static_cast<size_t>(hash % (options.maxSize - options.minSize + 1));
+    }
+
+    char payloadChar(uint64_t seq) { return static_cast<char>('a' + seq % 26); }
+
+    // 当前常驻内存（字节）；拿不到时返回峰值
+    uint64_t residentBytes() {
+#ifdef __linux__
+        std::ifstream statm("/proc/self/statm");
+        uint64_t pages = 0;
+        uint64_t resident = 0;
+        if (statm >> pages >> resident) return resident * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+#endif
+#ifndef _WIN32
+        rusage usage{};
+        getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+        return static_cast<uint64_t>(usage.ru_maxrss);
+#else
+        return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+#else
+        return 0;
+#endif
+    }
+
+    struct Producer {
+        uint64_t produced = 0;
+        std::vector<uint32_t> latencies;// 抽样的调用耗时（纳秒）
+    };
+
+    void produce(const Options &options, size_t thread, const std::atomic<bool> &stop, Producer &result) {
+        constexpr uint64_t kSampleEvery = 16;
+        std::string payload(options.maxSize, '\0');
+        result.latencies.reserve(1 << 16);
+        uint64_t seq = 0;
+        while (!stop.load(std::memory_order_relaxed)) {
+            size_t size = payloadSize(options, thread, seq);
+            std::fill_n(payload.begin(), size, payloadChar(seq));
+            std::string_view text(payload.data(), size);
+            if (seq % kSampleEvery == 0) {
+                auto start = std::chrono::steady_clock::now();
+                PebbleLog::info("soak t={} seq={} {}", thread, seq, text);
+                auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+                result.latencies.push_back(static_cast<uint32_t>(std::min<int64_t>(elapsed, UINT32_MAX)));
+            } else {
+                PebbleLog::info("soak t={} seq={} {}", thread, seq, text);
+            }
+            ++seq;
+        }
+        result.produced = seq;
+    }
+
+    struct Verification {
+        uint64_t records = 0;
+        uint64_t lost = 0;
+        uint64_t duplicated = 0;
+        uint64_t reordered = 0;
+        uint64_t corrupted = 0;// 解析失败、长度或内容不符
+        uint64_t truncatedHead = 0;// 轮转删除最早文件而无法检查的记录
+
+        bool ok() const { return lost == 0 && duplicated == 0 && reordered == 0 && corrupted == 0; }
+    };
+
+    bool parseNumber(std::string_view &text, uint64_t &value) {
+        auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+        if (result.ec != std::errc()) return false;
+        text.remove_prefix(static_cast<size_t>(result.ptr - text.data()));
+        return true;
+    }
+
+    // 按从旧到新的顺序读取所有文件，逐行检查每个线程的序号
+    Verification verify(const Options &options, const std::vector<Producer> &producers, bool historyComplete) {
+        Verification result;
+        std::vector<int64_t> last(producers.size(), -1);
+        std::string base = options.dir + "/" + std::string(kLogName);
+        std::vector<std::string> files;
+        for (size_t i = 1;; ++i) {
+            std::string name = base + "." + std::to_string(i);
+            if (!std::filesystem::exists(name)) break;
+            files.push_back(name);
+        }
+        std::reverse(files.begin(), files.end());
+        files.push_back(base);
+
+        std::string line;
+        for (const std::string &file: files) {
+            std::ifstream in(file, std::ios::binary);
+            while (std::getline(in, line)) {
+                // 直接写入的文件在关闭前结尾可能有补齐的零
+                if (line.find_first_not_of('\0') == std::string::npos) continue;
+                size_t marker = line.find(kMarker);
+                if (marker == std::string::npos) continue;// 指标等其他日志
+                std::string_view rest = std::string_view(line).substr(marker + kMarker.size());
+                uint64_t thread = 0;
+                uint64_t seq = 0;
+                if (!parseNumber(rest, thread) || !rest.starts_with(" seq=") || (rest.remove_prefix(5), !parseNumber(rest, seq)) ||
+                    thread >= producers.size() || !rest.starts_with(' ')) {
+                    ++result.corrupted;
+                    continue;
+                }
+                rest.remove_prefix(1);
+                ++result.records;
+                if (rest.size() != payloadSize(options, thread, seq) || rest.find_first_not_of(payloadChar(seq)) != std::string_view::npos) {
+                    ++result.corrupted;
+                }
+                int64_t &previous = last[thread];
+                int64_t current = static_cast<int64_t>(seq);
+                if (previous < 0) {
+                    // 第一条：历史完整时必须从 0 开始，否则之前的记录随最早的文件被删除
+                    if (historyComplete) {
+                        result.lost += seq;
+                    } else {
+                        result.truncatedHead += seq;
+                    }
+                } else if (current == previous) {
+                    ++result.duplicated;
+                    continue;
+                } else if (current < previous) {
+                    ++result.reordered;
+                    continue;
+                } else {
+                    result.lost += static_cast<uint64_t>(current - previous - 1);
+                }
+                previous = current;
+            }
+        }
+        // 结尾缺失的记录
+        for (size_t thread = 0; thread < producers.size(); ++thread) {
+            int64_t expectedLast = static_cast<int64_t>(producers[thread].produced) - 1;
+            if (last[thread] < expectedLast) {
+                uint64_t missing = static_cast<uint64_t>(expectedLast - last[thread]);
+                if (last[thread] < 0 && !historyComplete) {
+                    result.truncatedHead += missing;
+                } else {
+                    result.lost += missing;
+                }
+            }
+        }
+        return result;
+    }
+
+    uint32_t percentile(const std::vector<uint32_t> &sorted, double p) {
+        if (sorted.empty()) return 0;
+        return sorted[std::min(sorted.size() - 1, static_cast<size_t>(p * static_cast<double>(sorted.size())))];
+    }
+
+    bool parseArguments(int argc, char **argv, Options &options) {
+        for (int i = 1; i < argc; ++i) {
+            std::string_view arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--threads" && hasValue) {
+                if (!configfile::parseSize(argv[++i], options.threads) || options.threads == 0) return false;
+            } else if (arg == "--size" && hasValue) {
+                std::string_view value = argv[++i];
+                size_t dash = value.find('-');
+                if (!configfile::parseSize(value.substr(0, dash), options.minSize)) return false;
+                options.maxSize = options.minSize;
+                if (dash != std::string_view::npos && !configfile::parseSize(value.substr(dash + 1), options.maxSize)) return false;
+                if (options.maxSize < options.minSize) return false;
+            } else if (arg == "--duration" && hasValue) {
+                size_t seconds = 0;
+                if (!configfile::parseSize(argv[++i], seconds)) return false;
+                options.duration = std::chrono::seconds(seconds);
+            } else if (arg == "--dir" && hasValue) {
+                options.dir = argv[++i];
+            } else if (arg == "--max-file-size" && hasValue) {
+                if (!configfile::parseSize(argv[++i], options.maxFileSize)) return false;
+            } else if (arg == "--max-files" && hasValue) {
+                if (!configfile::parseSize(argv[++i], options.maxFiles) || options.maxFiles == 0) return false;
+            } else if (arg == "--direct") {
+                options.direct = true;
+            } else if (arg == "--sync") {
+                options.sync = true;
+            } else if (arg == "--no-verify") {
+                options.verify = false;
+            } else {
+                return false;
+            }
+        }
+        return true;
+    }
+}// namespace
+
+int main(int argc, char **argv) {
+    Options options;
+    if (!parseArguments(argc, argv, options)) {
+        std::fprintf(stderr, "usage: soakLog [--threads N] [--size BYTES|MIN-MAX] [--duration SECONDS] [--dir DIR]\n"
+                             "               [--max-file-size SIZE] [--max-files N] [--direct] [--sync] [--no-verify]\n");
+        return 2;
+    }
+
+    // 只删除上次运行留下的同名文件，不动目录中的其他内容
+    std::error_code ec;
+    std::filesystem::create_directories(options.dir, ec);
+    for (const auto &entry: std::filesystem::directory_iterator(options.dir, ec)) {
+        if (entry.path().filename().string().starts_with(kLogName)) std::filesystem::remove(entry.path(), ec);
+    }
+
+    PebbleLog::setLogType(LogType::FILE);
+    PebbleLog::setLogPath(options.dir);
+    PebbleLog::setLogName(std::string(kLogName));
+    PebbleLog::setMaxFileSize(options.maxFileSize);
+    PebbleLog::setMaxFileCount(options.maxFiles);
+    PebbleLog::setLogLevel(LogLevel::DEBUG);
+    if (options.direct) PebbleLog::setFileIo({.directIo = true, .preallocate = true});
+    if (options.sync) PebbleLog::setBackendMode(BackendMode::SYNC);
+
+    std::printf("soak: %zu threads, message %zu-%zu bytes, %lld s, max file %zu bytes x %zu\n", options.threads, options.minSize, options.maxSize,
+                static_cast<long long>(options.duration.count()), options.maxFileSize, options.maxFiles);
+
+    std::atomic<bool> stop{false};
+    std::vector<Producer> producers(options.threads);
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < options.threads; ++i) {
+        threads.emplace_back(produce, std::cref(options), i, std::cref(stop), std::ref(producers[i]));
+    }
+
+    // 每秒报告一次写出速度和内存
+    LogMetrics previous = PebbleLog::getMetrics();
+    uint64_t peakResident = 0;
+    for (int64_t second = 1; second <= options.duration.count(); ++second) {
+        std::this_thread::sleep_until(start + std::chrono::seconds(second));
+        LogMetrics current = PebbleLog::getMetrics();
+        uint64_t resident = residentBytes();
+        peakResident = std::max(peakResident, resident);
+        std::printf("[%3llds] records/s=%llu MB/s=%.1f rss=%.1fMB queue=%llu rotations=%llu\n", static_cast<long long>(second),
+                    static_cast<unsigned long long>(current.totalWritten() - previous.totalWritten()),
+                    static_cast<double>(current.bytesWritten - previous.bytesWritten) / (1024.0 * 1024.0), static_cast<double>(resident) / (1024.0 * 1024.0),
+                    static_cast<unsigned long long>(current.queueDepth), static_cast<unsigned long long>(current.rotations));
+        std::fflush(stdout);
+        previous = current;
+    }
+    stop.store(true, std::memory_order_relaxed);
+    for (auto &thread: threads) thread.join();
+    PebbleLog::flush();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    LogMetrics metrics = PebbleLog::getMetrics();
+    uint64_t produced = 0;
+    std::vector<uint32_t> latencies;
+    for (const Producer &producer: producers) {
+        produced += producer.produced;
+        latencies.insert(latencies.end(), producer.latencies.begin(), producer.latencies.end());
+    }
+    std::sort(latencies.begin(), latencies.end());
+    std::printf("produced %llu records in %.2f s: %.0f records/s, %.1f MB/s, peak rss %.1fMB, dropped %llu\n", static_cast<unsigned long long>(produced),
+                seconds, static_cast<double>(produced) / seconds, static_cast<double>(metrics.bytesWritten) / (1024.0 * 1024.0) / seconds,
+                static_cast<double>(peakResident) / (1024.0 * 1024.0), static_cast<unsigned long long>(metrics.dropped));
+    std::printf("enqueue latency ns: p50=%u p99=%u p99.9=%u max=%u (%zu samples)\n", percentile(latencies, 0.5), percentile(latencies, 0.99),
+                percentile(latencies, 0.999), latencies.empty() ? 0 : latencies.back(), latencies.size());
+    if (!options.verify) return 0;
+
+    // 创建过的文件数超过保留数量时，最早的文件已被删除
+    bool historyComplete = metrics.rotations + 1 <= options.maxFiles;
+    Verification result = verify(options, producers, historyComplete);
+    std::printf("verify: %llu records read, lost=%llu duplicated=%llu reordered=%llu corrupted=%llu%s\n", static_cast<unsigned long long>(result.records),
+                static_cast<unsigned long long>(result.lost), static_cast<unsigned long long>(result.duplicated),
+                static_cast<unsigned long long>(result.reordered), static_cast<unsigned long long>(result.corrupted),
+                historyComplete ? "" : std::format(" (oldest {} records rotated out)", result.truncatedHead).c_str());
+    std::printf("%s\n", result.ok() ? "PASS" : "FAIL");
+    return result.ok() ? 0 : 1;
+}
@@ -0,0 +1,181 @@
+#include "../PebbleLog_ho.hpp"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// 压缩输出的测试：内置 LZ 编解码的往返、帧的编解码和被破坏输入的处理，
+// 以及频繁刷新时帧仍按 frameSize 结束、刷新后文件结尾总是可以解压的完整帧
+
+using namespace utils::Log;
+
+static int failures = 0;
+
+#define EXPECT(condition)                                                             \
+    do {                                                                              \
+        if (!(condition)) {                                                           \
+            std::fprintf(stderr, "%s:%d: expected %s\n", __FILE__, __LINE__, #condition); \
+            ++failures;                                                               \
+        }                                                                             \
+    } while (0)
+
+static bool lzRoundTrip(const std::string &raw) {
+    std::string compressed(framefile::lz::bound(raw.size()), '\0');
+    compressed.resize(framefile::lz::compress(raw.data(), raw.size(), compressed.data()));
+    std::string restored(raw.size(), '\0');
+    return framefile::lz::decompress(compressed.data(), compressed.size(), restored.data(), restored.size()) && restored == raw;
+}
+
+static void testLz() {
+    std::mt19937 random(42);
+    auto randomBytes = [&random](size_t size) {
+        std::string text(size, '\0');
+        for (char &c: text) c = static_cast<char>(random());
+        return text;
+    };
+
+    EXPECT(lzRoundTrip(""));
+    EXPECT(lzRoundTrip("a"));
+    EXPECT(lzRoundTrip("abcdabcdabcd"));
+    // 字面量和匹配长度恰好跨过 15 和 15 + 255 的扩展边界
+    for (size_t length: {14, 15, 16, 18, 19, 20, 269, 270, 271, 274, 275, 1000}) {
+        EXPECT(lzRoundTrip(std::string(length, 'x')));
+        EXPECT(lzRoundTrip(randomBytes(length)));
+        EXPECT(lzRoundTrip(randomBytes(length) + std::string(length, 'y') + randomBytes(length)));
+    }
+    // 回溯距离接近上限
+    std::string block = randomBytes(1000);
+    EXPECT(lzRoundTrip(block + randomBytes(framefile::lz::kMaxDistance - 1000) + block));
+    EXPECT(lzRoundTrip(block + randomBytes(framefile::lz::kMaxDistance) + block));
+    // 不可压缩的数据和典型的日志行
+    EXPECT(lzRoundTrip(randomBytes(300000)));
+    std::string lines;
+    for (int i = 0; i < 5000; ++i) lines += "[2026-01-01 00:00:00.000] [INFO] [t=" + std::to_string(i % 7) + "] request id=" + std::to_string(i * 7919) + " done\n";
+    EXPECT(lzRoundTrip(lines));
+
+    // 被截断或被改动的输入不能越界，也不能报告成功却给出错误的结果
+    std::string compressed(framefile::lz::bound(lines.size()), '\0');
+    compressed.resize(framefile::lz::compress(lines.data(), lines.size(), compressed.data()));
+    EXPECT(compressed.size() < lines.size() / 2);
+    std::string restored(lines.size(), '\0');
+    for (size_t cut: {size_t(0), size_t(1), compressed.size() / 2, compressed.size() - 2}) {
+        EXPECT(!framefile::lz::decompress(compressed.data(), cut, restored.data(), restored.size()));
+    }
+    // 改动过的输入只要求不越界（在 AddressSanitizer 下运行时会被检查），结果不做要求
+    for (int i = 0; i < 200; ++i) {
+        std::string damaged = compressed;
+        damaged[random() % damaged.size()] ^= static_cast<char>(1 + random() % 255);
+        (void) framefile::lz::decompress(damaged.data(), damaged.size(), restored.data(), restored.size());
+    }
+}
+
+static void testFrames() {
+    std::string raw;
+    for (int i = 0; i < 2000; ++i) raw += "frame record " + std::to_string(i) + "\n";
+    std::vector<FileCompression> codecs = {FileCompression::LZ};
+    if (framefile::zlibAvailable()) codecs.push_back(FileCompression::ZLIB);
+    for (FileCompression codec: codecs) {
+        framefile::Header header{};
+        header.records = 2000;
+        std::string out;
+        framefile::encode(raw, codec, header, out);
+        framefile::Header parsed{};
+        EXPECT(framefile::readHeader(out, parsed));
+        EXPECT(parsed.rawLength == raw.size() && parsed.records == 2000);
+        EXPECT(parsed.codec == (codec == FileCompression::ZLIB ? framefile::kZlib : framefile::kLz));
+        std::string decoded;
+        EXPECT(framefile::decode(parsed, std::string_view(out).substr(sizeof(parsed)), decoded) && decoded == raw);
+        EXPECT(!framefile::readHeader(std::string_view(out).substr(0, out.size() - 1), parsed));
+    }
+    // 压缩后不比原文小时原样保存
+    std::string out;
+    framefile::encode("xyz", FileCompression::LZ, {}, out);
+    framefile::Header parsed{};
+    std::string decoded;
+    EXPECT(framefile::readHeader(out, parsed) && parsed.codec == framefile::kStored);
+    EXPECT(framefile::decode(parsed, std::string_view(out).substr(sizeof(parsed)), decoded) && decoded == "xyz");
+}
+
+// 读出文件中的全部帧，返回拼接后的原文和帧数
+static std::string readFrames(const std::string &path, size_t &frames) {
+    std::ifstream in(path, std::ios::binary);
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    std::string_view rest = data;
+    std::string text;
+    std::string raw;
+    framefile::Header header{};
+    frames = 0;
+    while (framefile::readHeader(rest, header)) {
+        EXPECT(framefile::decode(header, rest.substr(sizeof(header), header.compressedLength), raw));
+        text += raw;
+        rest.remove_prefix(sizeof(header) + header.compressedLength);
+        ++frames;
+    }
+    EXPECT(rest.find_first_not_of('\0') == std::string_view::npos);// 直接写入时结尾按页补零
+    return text;
+}
+
+static std::string recordText(int i) {
+    char text[32];
+    std::snprintf(text, sizeof(text), "compressed record %05d ", i);
+    return text;
+}
+
+static void testFileOutput(bool directIo) {
+    std::string dir = (std::filesystem::temp_directory_path() / ("pebblelog-compression-" + std::to_string(::getpid()))).string();
+    std::filesystem::remove_all(dir);
+    LogConfig config = PebbleLog::getConfig();
+    config.type = LogType::FILE;
+    config.logPath = dir;
+    config.logName = directIo ? "direct.log" : "app.log";
+    config.maxFileSize = 1ull << 30;
+    config.compression = {FileCompression::LZ, 64 * 1024};
+    config.fileIo.directIo = directIo;
+    PebbleLog::setConfig(config);
+    std::string path = dir + "/" + config.logName + ".pbz";
+
+    // 频繁刷新：帧仍然按 frameSize 结束，每次刷新后文件结尾都是包含最新记录、可以解压的完整帧
+    constexpr int kRecords = 6000;
+    for (int i = 0; i < kRecords; ++i) {
+        PebbleLog::info("compressed record {:05} {}", i, std::string(static_cast<size_t>(i % 40), 'p'));
+        if (i % 25 == 0) {
+            PebbleLog::flush();
+            size_t frames = 0;
+            EXPECT(readFrames(path, frames).ends_with(recordText(i) + std::string(static_cast<size_t>(i % 40), 'p') + "\n"));
+        }
+    }
+    PebbleLog::flush();
+    PebbleLog::setLogType(LogType::CONSOLE);// 关闭文件，结束最后一帧
+    PebbleLog::flush();
+
+    size_t frames = 0;
+    std::string text = readFrames(path, frames);
+    size_t lines = 0;
+    size_t position = 0;
+    for (int i = 0; i < kRecords; ++i) {
+        size_t found = text.find(recordText(i), position);
+        EXPECT(found != std::string::npos);
+        if (found == std::string::npos) break;
+        position = found;
+        ++lines;
+    }
+    EXPECT(lines == kRecords);
+    EXPECT(frames <= text.size() / (64 * 1024) + 1);// 刷新不会把帧切碎
+    std::filesystem::remove_all(dir);
+}
+
+int main() {
+    testLz();
+    testFrames();
+    testFileOutput(false);
+    testFileOutput(true);
+    if (failures != 0) {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    std::printf("compression: all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,156 @@
+#include "../PebbleLog_ho.hpp"
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// 套接字输出的回环测试：在临时路径上监听 Unix 套接字，启用 SocketSink 后检查收到的帧。
+// 消息中带换行时，流式 syslog 必须按 RFC 6587 的长度前缀分帧，接收方才能还原出完整的一条
+
+using namespace utils::Log;
+
+static int failures = 0;
+
+#define EXPECT(condition)                                                             \
+    do {                                                                              \
+        if (!(condition)) {                                                           \
+            std::fprintf(stderr, "%s:%d: expected %s\n", __FILE__, __LINE__, #condition); \
+            ++failures;                                                               \
+        }                                                                             \
+    } while (0)
+
+static const std::string kMessages[] = {"plain record", "first line\nsecond line\n", "tab\tand \"quotes\"", std::string(3000, 'x')};
+
+// 监听 path，接收超时为 5 秒
+static int listenOn(const std::string &path, int type) {
+    ::unlink(path.c_str());
+    int fd = ::socket(AF_UNIX, type | SOCK_CLOEXEC, 0);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    if (fd < 0 || ::bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0) return -1;
+    if (type == SOCK_STREAM && ::listen(fd, 1) != 0) return -1;
+    timeval timeout{5, 0};
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    return fd;
+}
+
+static void logAll() {
+    for (const std::string &message: kMessages) PebbleLog::info("{}", message);
+    PebbleLog::flush();
+}
+
+// syslog 帧的 MSG 部分：跳过 "<PRI>1 时间 主机 应用 进程号 - - "
+static std::string_view syslogMessage(std::string_view frame) {
+    size_t position = 0;
+    for (int fields = 0; fields < 7 && position != std::string_view::npos; ++fields) {
+        position = frame.find(' ', position);
+        if (position != std::string_view::npos) ++position;
+    }
+    return position == std::string_view::npos ? std::string_view{} : frame.substr(position);
+}
+
+static void testDatagram(const std::string &path) {
+    int server = listenOn(path, SOCK_DGRAM);
+    EXPECT(server >= 0);
+    if (server < 0) return;
+    SocketSinkOptions options;
+    options.path = path;
+    options.appName = "socket-test";
+    EXPECT(PebbleLog::enableSocketSink(options));
+    logAll();
+    char buffer[65536];
+    for (const std::string &expected: kMessages) {
+        ssize_t length = ::recv(server, buffer, sizeof(buffer), 0);
+        EXPECT(length > 0);
+        if (length <= 0) break;
+        std::string_view frame(buffer, static_cast<size_t>(length));
+        EXPECT(frame.starts_with("<14>1 "));// facility user，INFO 对应 severity 6
+        EXPECT(frame.find(" socket-test ") != std::string_view::npos);
+        EXPECT(syslogMessage(frame) == expected);
+    }
+    PebbleLog::disableSocketSink();
+    ::close(server);
+    ::unlink(path.c_str());
+}
+
+// 读取流式连接上的全部数据，直到发送方关闭连接或超时
+static std::string readStream(int connection) {
+    std::string data;
+    char buffer[65536];
+    while (true) {
+        ssize_t length = ::recv(connection, buffer, sizeof(buffer), 0);
+        if (length <= 0) break;
+        data.append(buffer, static_cast<size_t>(length));
+    }
+    return data;
+}
+
+static void testStream(const std::string &path, SocketFraming framing) {
+    int server = listenOn(path, SOCK_STREAM);
+    EXPECT(server >= 0);
+    if (server < 0) return;
+    SocketSinkOptions options;
+    options.path = path;
+    options.type = SocketType::STREAM;
+    options.framing = framing;
+    EXPECT(PebbleLog::enableSocketSink(options));
+    logAll();
+    PebbleLog::disableSocketSink();// 停用时发出剩余的记录后关闭连接，数据留在接收缓冲中
+    int connection = ::accept(server, nullptr, nullptr);
+    EXPECT(connection >= 0);
+    if (connection < 0) {
+        ::close(server);
+        return;
+    }
+    timeval timeout{5, 0};
+    ::setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    std::string data = readStream(connection);
+
+    std::vector<std::string_view> frames;
+    std::string_view rest = data;
+    while (!rest.empty()) {
+        size_t length = 0;
+        if (framing == SocketFraming::SYSLOG) {
+            // RFC 6587 八位组计数：十进制长度、一个空格、长度指定的字节数
+            size_t space = rest.find(' ');
+            if (space == std::string_view::npos || std::from_chars(rest.data(), rest.data() + space, length).ptr != rest.data() + space) break;
+            rest.remove_prefix(space + 1);
+        } else {
+            if (rest.size() < 4) break;
+            for (int i = 3; i >= 0; --i) length = length << 8 | static_cast<unsigned char>(rest[static_cast<size_t>(i)]);
+            rest.remove_prefix(4);
+        }
+        if (rest.size() < length) break;
+        frames.push_back(rest.substr(0, length));
+        rest.remove_prefix(length);
+    }
+    EXPECT(rest.empty());
+    EXPECT(frames.size() == std::size(kMessages));
+    for (size_t i = 0; i < std::min(frames.size(), std::size(kMessages)); ++i) {
+        if (framing == SocketFraming::SYSLOG) {
+            EXPECT(syslogMessage(frames[i]) == kMessages[i]);
+        } else {
+            EXPECT(frames[i].ends_with(kMessages[i]));// 原生格式带有按输出格式生成的前缀
+        }
+    }
+    ::close(connection);
+    ::close(server);
+    ::unlink(path.c_str());
+}
+
+int main() {
+    PebbleLog::setLogType(LogType::NONE);
+    std::string base = "/tmp/pebblelog-socket-" + std::to_string(::getpid());
+    testDatagram(base + ".dgram");
+    testStream(base + ".syslog", SocketFraming::SYSLOG);
+    testStream(base + ".native", SocketFraming::NATIVE);
+    if (failures != 0) {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    std::printf("socket sink: all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,66 @@
+#include "../PebbleLog_ho.hpp"
+#include <csignal>
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+// pebble-collector：独立的收集进程，创建共享内存环并负责所有输出和轮转，
+// 各生产者进程调用 PebbleLog::attachSharedRing 连接。收到 SIGINT/SIGTERM 时取完剩余记录后退出
+//
+//   pebble-collector [--config 配置文件] [--slots 槽位数] <共享内存名>
+//
+// 指定配置文件时会监视其变化，修改级别、输出目标和轮转设置无需重启收集进程
+
+using namespace utils::Log;
+
+static void usage() {
+    std::fprintf(stderr, "usage: pebble-collector [--config FILE] [--slots N] NAME\n"
+                         "  NAME is a shared memory name such as /app-log\n");
+}
+
+int main(int argc, char **argv) {
+    std::string name;
+    std::string configFile;
+    size_t slots = 16384;
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--config" && hasValue) {
+            configFile = argv[++i];
+        } else if (arg == "--slots" && hasValue) {
+            slots = std::stoul(argv[++i]);
+        } else if (!arg.starts_with("--") && name.empty()) {
+            name = arg;
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (name.empty()) {
+        usage();
+        return 2;
+    }
+
+#ifdef _WIN32
+    std::fprintf(stderr, "shared ring collection is not supported on this platform\n");
+    return 1;
+#else
+    // 在创建任何线程之前屏蔽信号，由主线程同步等待
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    if (!configFile.empty() && !PebbleLog::watchConfigFile(configFile)) return 1;
+    if (!PebbleLog::startSharedRingCollector(name, slots)) return 1;
+
+    int received = 0;
+    sigwait(&signals, &received);
+
+    PebbleLog::stopSharedRingCollector();
+    PebbleLog::unwatchConfigFile();
+    PebbleLog::flush();
+    return 0;
+#endif
+}
@@ -0,0 +1,451 @@
+#include "../PebbleLog_ho.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <limits>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+// pebble-query：按时间范围、级别和子串查询日志文件及其轮转备份。
+// 有 .idx 索引时先二分查找索引确定需要读取的段，只有这些段会被访问；没有索引的部分整段扫描。
+// 压缩输出的 .pbz 文件按帧头中的时间和级别跳过整帧，只解压可能匹配的帧。
+//
+//   pebble-query [--from 时间] [--to 时间] [--level 级别[,级别...]] [--grep 文本] [--count] <日志文件>
+//
+// 时间可以是 "YYYY-MM-DD HH:MM:SS[.小数]"（本地时间）或 Unix 秒。
+// 索引只能精确到段；行首是默认时间格式或 JSON 输出的 time 字段时，会再按行精确过滤时间。
+// 级别按行匹配 "[LEVEL]" 或 JSON 的 "level":"LEVEL"
+
+using namespace utils::Log;
+
+namespace {
+    constexpr int64_t kNanosPerSecond = 1000000000;
+
+    // 只读映射一个文件；不支持 mmap 的平台读入内存
+    class MappedFile {
+    public:
+        explicit MappedFile(const std::string &path) {
+            std::error_code ec;
+            auto fileSize = std::filesystem::file_size(path, ec);
+            if (ec) return;
+            exists = true;
+            size = static_cast<size_t>(fileSize);
+            if (size == 0) return;
+#ifndef _WIN32
+            int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0) {
+                exists = false;
+                return;
+            }
+            void *address = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            ::close(fd);
+            if (address == MAP_FAILED) {
+                exists = false;
+                return;
+            }
+            // 按顺序读取，提示内核提前预读
+            ::madvise(address, size, MADV_SEQUENTIAL);
+            mapped = static_cast<const char *>(address);
+#else
+            std::ifstream in(path, std::ios::binary);
+            copy.resize(size);
+            in.read(copy.data(), static_cast<std::streamsize>(size));
+            size = static_cast<size_t>(in.gcount());
+            mapped = copy.data();
+#endif
+        }
+
+        ~MappedFile() {
+#ifndef _WIN32
+            if (mapped) ::munmap(const_cast<char *>(mapped), size);
+#endif
+        }
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        bool valid() const { return exists; }
+        std::string_view view() const { return {mapped ? mapped : "", mapped ? size : 0}; }
+
+    private:
+        bool exists = false;
+        const char *mapped = nullptr;
+        size_t size = 0;
+#ifdef _WIN32
+        std::string copy;
+#endif
+    };
+
+    // 子串查找：同时比较候选位置的首字节和末字节，一次筛掉 16/32 个位置，剩下的候选再逐个比较。
+    // x86 上运行时选择 AVX2 或 SSE2，其他平台使用标准库
+    namespace search {
+        inline size_t findScalar(std::string_view haystack, std::string_view needle) { return haystack.find(needle); }
+
+#if defined(PEBBLELOG_HAS_SSE2)
+        inline size_t findSse2(std::string_view haystack, std::string_view needle) {
+            size_t k = needle.size();
+            if (k == 0) return 0;
+            if (haystack.size() < k) return std::string_view::npos;
+            const char *data = haystack.data();
+            const __m128i first = _mm_set1_epi8(needle.front());
+            const __m128i last = _mm_set1_epi8(needle.back());
+            size_t i = 0;
+            for (; i + k - 1 + 16 <= haystack.size(); i += 16) {
+                __m128i blockFirst = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+                __m128i blockLast = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i + k - 1));
+                unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(blockFirst, first), _mm_cmpeq_epi8(blockLast, last))));
+                while (mask) {
+                    size_t candidate = i + static_cast<size_t>(std::countr_zero(mask));
+                    if (k <= 2 || std::memcmp(data + candidate + 1, needle.data() + 1, k - 2) == 0) return candidate;
+                    mask &= mask - 1;
+                }
+            }
+            size_t rest = haystack.substr(i).find(needle);
+            return rest == std::string_view::npos ? rest : i + rest;
+        }
+#endif
+
+#if defined(PEBBLELOG_HAS_AVX2_KERNEL)
+        __attribute__((target("avx2"))) inline size_t findAvx2(std::string_view haystack, std::string_view needle) {
+            size_t k = needle.size();
+            if (k == 0) return 0;
+            if (haystack.size() < k) return std::string_view::npos;
+            const char *data = haystack.data();
+            const __m256i first = _mm256_set1_epi8(needle.front());
+            const __m256i last = _mm256_set1_epi8(needle.back());
+            size_t i = 0;
+            for (; i + k - 1 + 32 <= haystack.size(); i += 32) {
+                __m256i blockFirst = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+                __m256i blockLast = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i + k - 1));
+                unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(blockFirst, first), _mm256_cmpeq_epi8(blockLast, last))));
+                while (mask) {
+                    size_t candidate = i + static_cast<size_t>(std::countr_zero(mask));
+                    if (k <= 2 || std::memcmp(data + candidate + 1, needle.data() + 1, k - 2) == 0) return candidate;
+                    mask &= mask - 1;
+                }
+            }
+            size_t rest = findSse2(haystack.substr(i), needle);
+            return rest == std::string_view::npos ? rest : i + rest;
+        }
+#endif
+
+        using FindFunction = size_t (*)(std::string_view, std::string_view);
+
+        inline FindFunction selectKernel() {
+#if defined(PEBBLELOG_HAS_AVX2_KERNEL)
+            if (__builtin_cpu_supports("avx2")) return &findAvx2;
+#endif
+#if defined(PEBBLELOG_HAS_SSE2)
+            return &findSse2;
+#else
+            return &findScalar;
+#endif
+        }
+
+        inline size_t find(std::string_view haystack, std::string_view needle) {
+            static const FindFunction kernel = selectKernel();
+            return kernel(haystack, needle);
+        }
+    }// namespace search
+
+    struct Query {
+        int64_t from = std::numeric_limits<int64_t>::min();
+        int64_t to = std::numeric_limits<int64_t>::max();
+        uint32_t levelMask = 0;// 0 表示不按级别过滤
+        std::vector<std::string> levelTokens;
+        std::string text;
+        bool countOnly = false;
+    };
+
+    struct Stats {
+        size_t matched = 0;
+        size_t scannedBytes = 0;
+        size_t skippedBytes = 0;
+    };
+
+    // "YYYY-MM-DD HH:MM:SS" 按本地时间换算；同一秒内的行很多，缓存换算结果
+    bool parseLocalSeconds(std::string_view text, int64_t &seconds) {
+        static std::unordered_map<std::string, int64_t> cache;
+        if (text.size() < 19 || text[4] != '-' || text[10] != ' ' || text[13] != ':') return false;
+        std::string key(text.substr(0, 19));
+        if (auto it = cache.find(key); it != cache.end()) {
+            seconds = it->second;
+            return true;
+        }
+        std::tm tm{};
+        if (std::sscanf(key.c_str(), "%4d-%2d-%2d %2d:%2d:%2d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday, &tm.tm_hour, &tm.tm_min, &tm.tm_sec) != 6) return false;
+        tm.tm_year -= 1900;
+        tm.tm_mon -= 1;
+        tm.tm_isdst = -1;
+        std::time_t result = std::mktime(&tm);
+        if (result == static_cast<std::time_t>(-1)) return false;
+        if (cache.size() > 4096) cache.clear();
+        seconds = cache.emplace(std::move(key), static_cast<int64_t>(result)).first->second;
+        return true;
+    }
+
+    // 秒之后可选的小数部分，按位数补齐到纳秒
+    int64_t parseFraction(std::string_view text) {
+        if (text.empty() || text.front() != '.') return 0;
+        int64_t nanos = 0;
+        int digits = 0;
+        for (size_t i = 1; i < text.size() && digits < 9 && text[i] >= '0' && text[i] <= '9'; ++i, ++digits) {
+            nanos = nanos * 10 + (text[i] - '0');
+        }
+        for (; digits < 9; ++digits) nanos *= 10;
+        return nanos;
+    }
+
+    bool parseTimeArgument(std::string_view text, int64_t &nanos) {
+        int64_t seconds = 0;
+        if (parseLocalSeconds(text, seconds)) {
+            nanos = seconds * kNanosPerSecond + parseFraction(text.substr(19));
+            return true;
+        }
+        if (text.empty() || text.size() > 12) return false;
+        for (char c: text) {
+            if (c < '0' || c > '9') return false;
+            seconds = seconds * 10 + (c - '0');
+        }
+        nanos = seconds * kNanosPerSecond;
+        return true;
+    }
+
+    // 行首的时间：默认布局 "[YYYY-MM-DD HH:MM:SS"，或 JSON 输出的 {"time":"YYYY-MM-DD HH:MM:SS...
+    bool parseLineTime(std::string_view line, int64_t &nanos) {
+        constexpr std::string_view kJsonTime = "{\"time\":\"";
+        if (line.starts_with(kJsonTime)) {
+            line.remove_prefix(kJsonTime.size());
+        } else if (line.starts_with('[')) {
+            line.remove_prefix(1);
+        }
+        int64_t seconds = 0;
+        if (!parseLocalSeconds(line, seconds)) return false;
+        nanos = seconds * kNanosPerSecond + parseFraction(line.substr(19));
+        return true;
+    }
+
+    bool lineMatches(std::string_view line, const Query &query, bool checkText) {
+        if (query.from != std::numeric_limits<int64_t>::min() || query.to != std::numeric_limits<int64_t>::max()) {
+            int64_t nanos = 0;
+            if (parseLineTime(line, nanos) && (nanos < query.from || nanos > query.to)) return false;
+        }
+        if (!query.levelTokens.empty()) {
+            bool found = false;
+            for (const std::string &token: query.levelTokens) {
+                if (search::find(line, token) != std::string_view::npos) {
+                    found = true;
+                    break;
+                }
+            }
+            if (!found) return false;
+        }
+        return !checkText || search::find(line, query.text) != std::string_view::npos;
+    }
+
+    void emit(std::string_view line, const Query &query, Stats &stats) {
+        ++stats.matched;
+        if (query.countOnly) return;
+        std::fwrite(line.data(), 1, line.size(), stdout);
+        std::fputc('\n', stdout);
+    }
+
+    // 扫描一段连续的记录。有子串条件时先在整段中查找子串，再扩展到所在的行，不必逐行比较
+    void scanRegion(std::string_view region, const Query &query, Stats &stats) {
+        stats.scannedBytes += region.size();
+        size_t position = 0;
+        while (position < region.size()) {
+            size_t lineBegin = position;
+            if (!query.text.empty()) {
+                size_t hit = search::find(region.substr(position), query.text);
+                if (hit == std::string_view::npos) return;
+                hit += position;
+                size_t newline = region.rfind('\n', hit);
+                lineBegin = newline == std::string_view::npos || newline < position ? position : newline + 1;
+            }
+            size_t lineEnd = region.find('\n', lineBegin);
+            if (lineEnd == std::string_view::npos) lineEnd = region.size();
+            std::string_view line = region.substr(lineBegin, lineEnd - lineBegin);
+            if (lineMatches(line, query, false)) emit(line, query, stats);
+            position = lineEnd + 1;
+        }
+    }
+
+    std::span<const fileindex::Entry> loadIndex(const MappedFile &index) {
+        std::string_view data = index.view();
+        if (data.size() < sizeof(fileindex::kMagic) || std::memcmp(data.data(), fileindex::kMagic, sizeof(fileindex::kMagic)) != 0) return {};
+        data.remove_prefix(sizeof(fileindex::kMagic));
+        return {reinterpret_cast<const fileindex::Entry *>(data.data()), data.size() / sizeof(fileindex::Entry)};
+    }
+
+    // 依次读取帧头，不满足条件的帧不解压。最后一帧可能还没有写完，读到不完整的帧头为止。
+    // 直接写入的进程被强行终止时，结尾按页补的零会留在文件中，之后重新打开时接着写，这里跳过这些零
+    void queryFrames(std::string_view data, const Query &query, Stats &stats) {
+        std::string raw;
+        framefile::Header header{};
+        while (true) {
+            if (!framefile::readHeader(data, header)) {
+                size_t next = data.find_first_not_of('\0');
+                if (next == 0 || next == std::string_view::npos) break;
+                data.remove_prefix(next);
+                continue;
+            }
+            std::string_view payload = data.substr(sizeof(framefile::Header), header.compressedLength);
+            data.remove_prefix(sizeof(framefile::Header) + header.compressedLength);
+            bool inRange = header.maxNanos >= query.from && header.minNanos <= query.to;
+            bool hasLevel = query.levelMask == 0 || (header.levelMask & query.levelMask) != 0;
+            if (!inRange || !hasLevel) {
+                stats.skippedBytes += sizeof(framefile::Header) + payload.size();
+                continue;
+            }
+            if (!framefile::decode(header, payload, raw)) {
+                std::fprintf(stderr, "corrupt or unsupported frame (codec %u), skipped\n", header.codec);
+                continue;
+            }
+            scanRegion(raw, query, stats);
+        }
+    }
+
+    void querySegment(const std::string &path, const Query &query, Stats &stats) {
+        MappedFile log(path);
+        if (!log.valid()) return;
+        std::string_view data = log.view();
+        if (data.starts_with(std::string_view(framefile::kMagic, sizeof(framefile::kMagic)))) {
+            queryFrames(data, query, stats);
+            return;
+        }
+        // 直接写入的文件在关闭前结尾可能有补齐到页的零
+        while (!data.empty() && data.back() == '\0') data.remove_suffix(1);
+        MappedFile indexFile(fileindex::pathFor(path));
+        std::span<const fileindex::Entry> entries = loadIndex(indexFile);
+        size_t scannedBefore = stats.scannedBytes;
+        if (entries.empty()) {
+            scanRegion(data, query, stats);
+            return;
+        }
+
+        // 段内时间不保证有序，二分查找前先求 maxNanos 的前缀最大值和 minNanos 的后缀最小值，两者都单调
+        std::vector<int64_t> maxSoFar(entries.size());
+        std::vector<int64_t> minAfter(entries.size());
+        for (size_t i = 0; i < entries.size(); ++i) {
+            maxSoFar[i] = i == 0 ? entries[i].maxNanos : std::max(maxSoFar[i - 1], entries[i].maxNanos);
+        }
+        for (size_t i = entries.size(); i-- > 0;) {
+            minAfter[i] = i + 1 == entries.size() ? entries[i].minNanos : std::min(minAfter[i + 1], entries[i].minNanos);
+        }
+        size_t begin = static_cast<size_t>(std::lower_bound(maxSoFar.begin(), maxSoFar.end(), query.from) - maxSoFar.begin());
+        size_t end = static_cast<size_t>(std::upper_bound(minAfter.begin(), minAfter.end(), query.to) - minAfter.begin());
+
+        // 没有索引覆盖的部分（开启索引之前写入的内容、尚未结束的最后一段）整段扫描
+        auto scanGap = [&](uint64_t from, uint64_t to) {
+            to = std::min<uint64_t>(to, data.size());
+            if (from < to) scanRegion(data.substr(from, to - from), query, stats);
+        };
+        uint64_t previousEnd = begin == 0 ? 0 : entries[begin - 1].offset + entries[begin - 1].length;
+        for (size_t i = begin; i < end; ++i) {
+            const fileindex::Entry &entry = entries[i];
+            scanGap(previousEnd, entry.offset);
+            previousEnd = entry.offset + entry.length;
+            bool inRange = entry.maxNanos >= query.from && entry.minNanos <= query.to;
+            bool hasLevel = query.levelMask == 0 || (entry.levelMask & query.levelMask) != 0;
+            if (!inRange || !hasLevel || entry.offset >= data.size()) continue;
+            scanRegion(data.substr(entry.offset, std::min<uint64_t>(entry.length, data.size() - entry.offset)), query, stats);
+        }
+        if (end < entries.size()) {
+            scanGap(previousEnd, entries[end].offset);
+        } else {
+            scanGap(previousEnd, data.size());
+        }
+        stats.skippedBytes += data.size() - std::min<size_t>(data.size(), stats.scannedBytes - scannedBefore);
+    }
+
+    bool parseLevels(std::string_view text, Query &query) {
+        static constexpr std::pair<std::string_view, LogLevel> names[] = {
+                {"DEBUG", LogLevel::DEBUG}, {"INFO", LogLevel::INFO}, {"WARN", LogLevel::WARN},
+                {"ERROR", LogLevel::ERROR}, {"FATAL", LogLevel::FATAL}, {"TRACE", LogLevel::TRACE}};
+        while (!text.empty()) {
+            size_t comma = text.find(',');
+            std::string_view name = text.substr(0, comma);
+            text = comma == std::string_view::npos ? std::string_view() : text.substr(comma + 1);
+            bool known = false;
+            for (const auto &[candidate, level]: names) {
+                if (candidate != name) continue;
+                query.levelMask |= 1u << static_cast<uint32_t>(level);
+                query.levelTokens.push_back("[" + std::string(name) + "]");
+                query.levelTokens.push_back("\"level\":\"" + std::string(name) + "\"");
+                known = true;
+            }
+            if (!known) return false;
+        }
+        return true;
+    }
+
+    void usage() {
+        std::fprintf(stderr,
+                     "usage: pebble-query [--from TIME] [--to TIME] [--level LEVEL[,LEVEL...]] [--grep TEXT] [--count] LOGFILE\n"
+                     "  TIME is \"YYYY-MM-DD HH:MM:SS[.fraction]\" in local time or Unix seconds\n"
+                     "  LOGFILE and its rotated siblings LOGFILE.1, LOGFILE.2, ... are searched oldest first\n");
+    }
+}// namespace
+
+int main(int argc, char **argv) {
+    Query query;
+    std::string logFile;
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--from" && hasValue) {
+            if (!parseTimeArgument(argv[++i], query.from)) {
+                std::fprintf(stderr, "invalid time: %s\n", argv[i]);
+                return 2;
+            }
+        } else if (arg == "--to" && hasValue) {
+            if (!parseTimeArgument(argv[++i], query.to)) {
+                std::fprintf(stderr, "invalid time: %s\n", argv[i]);
+                return 2;
+            }
+        } else if (arg == "--level" && hasValue) {
+            if (!parseLevels(argv[++i], query)) {
+                std::fprintf(stderr, "invalid level: %s\n", argv[i]);
+                return 2;
+            }
+        } else if (arg == "--grep" && hasValue) {
+            query.text = argv[++i];
+        } else if (arg == "--count") {
+            query.countOnly = true;
+        } else if (!arg.starts_with("--") && logFile.empty()) {
+            logFile = arg;
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (logFile.empty()) {
+        usage();
+        return 2;
+    }
+
+    // 轮转后编号越大越旧，从最旧的备份开始输出
+    std::vector<std::string> segments;
+    std::error_code ec;
+    for (int i = 1; std::filesystem::exists(logFile + "." + std::to_string(i), ec); ++i) {
+        segments.push_back(logFile + "." + std::to_string(i));
+    }
+    std::reverse(segments.begin(), segments.end());
+    segments.push_back(logFile);
+
+    Stats stats;
+    for (const std::string &segment: segments) querySegment(segment, query, stats);
+    std::fflush(stdout);
+    if (query.countOnly) std::printf("%zu\n", stats.matched);
+    std::fprintf(stderr, "matched %zu lines, scanned %zu bytes, skipped %zu bytes by index or frame header\n", stats.matched, stats.scannedBytes, stats.skippedBytes);
+    return stats.matched > 0 ? 0 : 1;
+}